@@ -4,6 +4,7 @@
 #include <iostream>
 
 #include "argus_utils/geometry/GeometryTypes.h"
+#include "argus_utils/utils/InterpolationTraits.hpp"
 #include "argus_utils/utils/LinalgTypes.h"
 
 // @todo: Deprecate Pose and move to sophus::se3d
@@ -103,5 +104,18 @@ protected:
 };
 
 std::ostream& operator<<( std::ostream& os, const PoseSE3& se3 );
+
+/*! \brief Poses interpolate along the geodesic from a to b. */
+template <>
+struct InterpolationTraits<PoseSE3>
+{
+	static const bool IsInterpolable = true;
+
+	static PoseSE3 Interpolate( const PoseSE3& a, const PoseSE3& b, double alpha )
+	{
+		PoseSE3::TangentVector delta = PoseSE3::Log( a.Inverse() * b );
+		return a * PoseSE3::Exp( alpha * delta );
+	}
+};
 	
 }
@@ -10,7 +10,7 @@
 
 namespace argus
 {
-template <typename Pose>
+template <typename Pose, typename LockPolicy = DefaultLockPolicy>
 class VelocityIntegrator
 {
 public:
@@ -19,6 +19,10 @@ public:
 	typedef typename Pose::TangentVector VelocityType;
 	typedef typename Pose::CovarianceMatrix CovarianceType;
 
+	typedef typename LockPolicy::Mutex Mutex;
+	typedef typename LockPolicy::ReadLock ReadLock;
+	typedef typename LockPolicy::WriteLock WriteLock;
+
 	VelocityIntegrator() : _maxBuffLen( 5.0 ) {}
 
 	VelocityIntegrator( const VelocityIntegrator& other )
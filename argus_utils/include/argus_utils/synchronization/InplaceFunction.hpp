@@ -0,0 +1,254 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "argus_utils/synchronization/PoolAllocator.hpp"
+
+namespace argus
+{
+
+template <typename Signature, size_t Capacity = 64>
+class InplaceFunction;
+
+/*! \brief A copyable function wrapper like boost::function, that stores
+ * callables of up to Capacity bytes in an inline buffer instead of on the
+ * heap. Larger or over-aligned callables are stored in PooledMemory, so
+ * constructing and copying never calls malloc once the pools have warmed up.
+ * Callables aligned beyond PooledMemory::Alignment fail to compile.
+ */
+template <typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R( Args... ), Capacity>
+{
+public:
+
+	typedef R result_type;
+
+	/*! \brief Returns whether a callable of type F is stored inline. */
+	template <typename F>
+	static bool IsInline()
+	{
+		return Traits<F>::IsInline;
+	}
+
+	InplaceFunction()
+	: _ops( nullptr ) {}
+
+	InplaceFunction( std::nullptr_t )
+	: _ops( nullptr ) {}
+
+	template <typename F,
+	          typename = typename std::enable_if<
+	              !std::is_same<typename std::decay<F>::type, InplaceFunction>::value>::type>
+	InplaceFunction( F&& func )
+	: _ops( nullptr )
+	{
+		typedef typename std::decay<F>::type Func;
+		Traits<Func>::Construct( &_storage, std::forward<F>( func ) );
+		_ops = Traits<Func>::GetOps();
+	}
+
+	InplaceFunction( const InplaceFunction& other )
+	: _ops( nullptr )
+	{
+		if( other._ops )
+		{
+			other._ops->copy( &_storage, &other._storage );
+			_ops = other._ops;
+		}
+	}
+
+	InplaceFunction( InplaceFunction&& other )
+	: _ops( nullptr )
+	{
+		TakeFrom( other );
+	}
+
+	~InplaceFunction()
+	{
+		clear();
+	}
+
+	InplaceFunction& operator=( const InplaceFunction& other )
+	{
+		if( this != &other )
+		{
+			InplaceFunction temp( other );
+			clear();
+			TakeFrom( temp );
+		}
+		return *this;
+	}
+
+	InplaceFunction& operator=( InplaceFunction&& other )
+	{
+		if( this != &other )
+		{
+			clear();
+			TakeFrom( other );
+		}
+		return *this;
+	}
+
+	R operator()( Args... args ) const
+	{
+		if( !_ops ) { throw std::bad_function_call(); }
+		return _ops->invoke( const_cast<Storage*>( &_storage ),
+		                     std::forward<Args>( args )... );
+	}
+
+	explicit operator bool() const
+	{
+		return _ops != nullptr;
+	}
+
+	bool empty() const
+	{
+		return _ops == nullptr;
+	}
+
+	void clear()
+	{
+		if( _ops )
+		{
+			_ops->destroy( &_storage );
+			_ops = nullptr;
+		}
+	}
+
+	void swap( InplaceFunction& other )
+	{
+		if( this == &other ) { return; }
+		InplaceFunction temp( std::move( other ) );
+		other = std::move( *this );
+		*this = std::move( temp );
+	}
+
+private:
+
+	typedef typename std::aligned_storage<Capacity>::type Storage;
+
+	struct Ops
+	{
+		R (*invoke)( Storage*, Args&&... );
+		void (*copy)( Storage*, const Storage* );
+		void (*move)( Storage*, Storage* ); // Also destroys the source
+		void (*destroy)( Storage* );
+	};
+
+	template <typename F,
+	          bool Inline = ( sizeof( F ) <= sizeof( Storage ) &&
+	                          std::alignment_of<F>::value <= std::alignment_of<Storage>::value )>
+	struct Traits
+	{
+		static const bool IsInline = true;
+
+		static F* Get( Storage* s ) { return reinterpret_cast<F*>( s ); }
+
+		template <typename G>
+		static void Construct( Storage* s, G&& func )
+		{
+			new ( s ) F( std::forward<G>( func ) );
+		}
+
+		static R Invoke( Storage* s, Args&&... args )
+		{
+			return (*Get( s ))( std::forward<Args>( args )... );
+		}
+
+		static void Copy( Storage* dst, const Storage* src )
+		{
+			new ( dst ) F( *Get( const_cast<Storage*>( src ) ) );
+		}
+
+		static void Move( Storage* dst, Storage* src )
+		{
+			new ( dst ) F( std::move( *Get( src ) ) );
+			Get( src )->~F();
+		}
+
+		static void Destroy( Storage* s )
+		{
+			Get( s )->~F();
+		}
+
+		static const Ops* GetOps()
+		{
+			static const Ops ops = { &Invoke, &Copy, &Move, &Destroy };
+			return &ops;
+		}
+	};
+
+	// Too large or aligned to store inline, so the buffer holds a pointer to
+	// pooled memory
+	template <typename F>
+	struct Traits<F, false>
+	{
+		static_assert( std::alignment_of<F>::value <= PooledMemory::Alignment,
+		               "InplaceFunction: Callable is aligned beyond PooledMemory::Alignment." );
+
+		static const bool IsInline = false;
+
+		static F*& Get( Storage* s ) { return *reinterpret_cast<F**>( s ); }
+
+		template <typename G>
+		static void Construct( Storage* s, G&& func )
+		{
+			void* mem = PooledMemory::Allocate( sizeof( F ) );
+			try
+			{
+				Get( s ) = new ( mem ) F( std::forward<G>( func ) );
+			}
+			catch( ... )
+			{
+				PooledMemory::Deallocate( mem, sizeof( F ) );
+				throw;
+			}
+		}
+
+		static R Invoke( Storage* s, Args&&... args )
+		{
+			return (*Get( s ))( std::forward<Args>( args )... );
+		}
+
+		static void Copy( Storage* dst, const Storage* src )
+		{
+			Construct( dst, *Get( const_cast<Storage*>( src ) ) );
+		}
+
+		static void Move( Storage* dst, Storage* src )
+		{
+			Get( dst ) = Get( src );
+		}
+
+		static void Destroy( Storage* s )
+		{
+			Get( s )->~F();
+			PooledMemory::Deallocate( Get( s ), sizeof( F ) );
+		}
+
+		static const Ops* GetOps()
+		{
+			static const Ops ops = { &Invoke, &Copy, &Move, &Destroy };
+			return &ops;
+		}
+	};
+
+	void TakeFrom( InplaceFunction& other )
+	{
+		if( other._ops )
+		{
+			other._ops->move( &_storage, &other._storage );
+			_ops = other._ops;
+			other._ops = nullptr;
+		}
+	}
+
+	Storage _storage;
+	const Ops* _ops;
+};
+
+}
@@ -1,26 +1,39 @@
 #pragma once
 
 #include <boost/foreach.hpp>
+#include <cmath>
+#include <deque>
+#include <map>
 #include <sstream>
 
 #include "argus_utils/synchronization/SynchronizationTypes.h"
-#include "argus_utils/utils/MapUtils.hpp"
+#include "argus_utils/utils/StampedRing.hpp"
 
 namespace argus
 {
 
-template<typename Msg, typename Key = std::string>
+/*! \brief Synchronizes buffers of timestamped data within some amount of
+ * tolerance, taking the data closest to the earliest time. RegisterSource
+ * returns a SourceHandle, which BufferData takes to index the source
+ * directly. Data are ordered by registration. */
+template<typename Msg, typename Key = std::string,
+         typename LockPolicy = DefaultLockPolicy>
 class MessageSynchronizer
 {
 public:
 
 	typedef std::tuple<Key, double, Msg> KeyedStampedData;
 
+	typedef typename LockPolicy::Mutex Mutex;
+	typedef typename LockPolicy::ReadLock ReadLock;
+	typedef typename LockPolicy::WriteLock WriteLock;
+
 	MessageSynchronizer()
 	{
 		SetBufferLength( 10 );
 		SetMaxDt( 0.1 );
 		SetMinSyncNum( 0 );
+		NameLock( _registryMutex, "MessageSynchronizer::registry" );
 	}
 
 	void SetBufferLength( double buffLen )
@@ -47,79 +60,127 @@ public:
 	}
 
 
-	void RegisterSource( const Key& key )
+	/*! \brief Registers a source and returns its handle. */
+	SourceHandle RegisterSource( const Key& key )
 	{
 		WriteLock lock( _registryMutex );
 		CheckStatus( key, false, lock );
-		_registry[key];
+		unsigned int index = _sources.size();
+		_indices[key] = index;
+		_sources.emplace_back( key );
+		NameLock( _sources.back().mutex, "MessageSynchronizer::source" );
+		return SourceHandle( index );
 	}
 
-	void BufferData( const Key& key, double stamp, const Msg& msg )
+	/*! \brief Returns the handle of a registered source. Throws if the
+	 * source is not registered. */
+	SourceHandle GetHandle( const Key& key ) const
 	{
 		ReadLock lock( _registryMutex );
 		CheckStatus( key, true, lock );
-		WriteLock regLock( _registry.at( key ).mutex );
-		_registry.at( key ).buffer.emplace( std::piecewise_construct,
-		                                    std::forward_as_tuple( stamp ),
-		                                    std::forward_as_tuple( msg ) );
+		return SourceHandle( _indices.at( key ) );
+	}
+
+	void BufferData( const Key& key, double stamp, const Msg& msg )
+	{
+		BufferData( GetHandle( key ), stamp, msg );
+	}
+
+	void BufferData( SourceHandle handle, double stamp, const Msg& msg )
+	{
+		ReadLock lock( _registryMutex );
+		if( handle.index >= _sources.size() )
+		{
+			std::stringstream ss;
+			ss << "Source handle: " << handle.index << " not registered!";
+			throw std::invalid_argument( ss.str() );
+		}
+		SourceRegistration& reg = _sources[handle.index];
+		WriteLock regLock( reg.mutex );
+		// Keeps the first datum at a repeated stamp
+		reg.buffer.Insert( stamp, msg );
 	}
 
 	bool GetOutput( double now, std::vector<KeyedStampedData>& out )
 	{
-		out.clear();
 		WriteLock lock( _registryMutex );
+		return FindOutput( out, lock );
+	}
 
-		unsigned int minSync = (_minSyncNum == 0) ? _registry.size() : _minSyncNum;
-
-		double earliest;
-		while( FindEarliestOverspan( earliest, lock ) )
+	/*! \brief Extracts every ready synchronized set under one lock, in time
+	 * order. Returns whether there were any. */
+	bool GetAllOutputs( double now, std::vector< std::vector<KeyedStampedData> >& outs )
+	{
+		WriteLock lock( _registryMutex );
+		outs.clear();
+		while( true )
 		{
-			unsigned int numReady = FindDataAtTime( earliest, out, false, lock );
-			if( numReady >= minSync )
+			outs.emplace_back();
+			if( !FindOutput( outs.back(), lock ) )
 			{
-				FindDataAtTime( earliest, out, true, lock );
-				return true;
+				outs.pop_back();
+				return !outs.empty();
 			}
-			RemoveBeforeInclusive( earliest, lock );
 		}
-		return false;
 	}
 
 private:
 
 	struct SourceRegistration
 	{
+		Key key;
 		mutable Mutex mutex;
-		std::map<double, Msg> buffer;
+		StampedRing<Msg> buffer;
+
+		SourceRegistration( const Key& k ) : key( k ) {}
 	};
 
-	typedef std::map<Key, SourceRegistration> SourceRegistry;
 	mutable Mutex _registryMutex;     // Locks all access to the registry
-	SourceRegistry _registry;
+	std::deque<SourceRegistration> _sources; // Indexed by handle
+	std::map<Key, unsigned int> _indices;
 
 	// Parameters
 	double _maxBufferLen;
 	double _maxDt;
 	unsigned int _minSyncNum;
 
+	bool FindOutput( std::vector<KeyedStampedData>& out, WriteLock& lock )
+	{
+		CheckLockOwnership( lock, &_registryMutex );
+		out.clear();
+
+		unsigned int minSync = (_minSyncNum == 0) ? _sources.size() : _minSyncNum;
+
+		double earliest;
+		while( FindEarliestOverspan( earliest, lock ) )
+		{
+			unsigned int numReady = FindDataAtTime( earliest, out, false, lock );
+			if( numReady >= minSync )
+			{
+				FindDataAtTime( earliest, out, true, lock );
+				return true;
+			}
+			RemoveBeforeInclusive( earliest, lock );
+		}
+		return false;
+	}
+
 	bool FindEarliestOverspan( double& earliest,
 	                           WriteLock& lock ) const
 	{
 		CheckLockOwnership( lock, &_registryMutex );
 
-		typedef typename SourceRegistry::value_type Item;
-		BOOST_FOREACH( const Item & item, _registry )
+		BOOST_FOREACH( const SourceRegistration& reg, _sources )
 		{
-			const SourceRegistration& reg = item.second;
 			ReadLock regLock( reg.mutex );
 			// if( reg.buffer.size() > _maxBufferLen )
 			// {
 			// 	earliest = get_lowest_key( reg.buffer );
 			// 	return true;
 			// }
-			if( reg.buffer.empty() ) { continue; }
-			earliest = get_lowest_key( reg.buffer );
-			double latest = get_highest_key( reg.buffer );
+			if( reg.buffer.Empty() ) { continue; }
+			earliest = reg.buffer.Front().first;
+			double latest = reg.buffer.Back().first;
 			if( (latest - earliest) > _maxBufferLen ) { return true; }
 		}
 		return false;
@@ -133,22 +194,19 @@ private:
 		CheckLockOwnership( lock, &_registryMutex );
 
 		unsigned int count = 0;
-		typename std::map<double, Msg>::const_iterator iter;
-		typedef typename SourceRegistry::value_type Item;
-		BOOST_FOREACH( Item & item, _registry )
+		size_t index;
+		BOOST_FOREACH( SourceRegistration& reg, _sources )
 		{
-			const Key& key = item.first;
-			SourceRegistration& reg = item.second;
 			WriteLock regLock( reg.mutex );
-			if( !get_closest_eq( reg.buffer, t, iter ) ) { continue; }
-			double closest = iter->first;
-			if( std::abs( closest - t ) > _maxDt ) { continue; }
+			if( !reg.buffer.FindClosest( t, index ) ) { continue; }
+			const typename StampedRing<Msg>::value_type& closest = reg.buffer[index];
+			if( std::abs( closest.first - t ) > _maxDt ) { continue; }
 
 			++count;
 			if( retrieve )
 			{
-				out.push_back( KeyedStampedData( key, iter->first, iter->second ) );
-				reg.buffer.erase( iter );
+				out.push_back( KeyedStampedData( reg.key, closest.first, closest.second ) );
+				reg.buffer.Erase( index );
 			}
 		}
 		return count;
@@ -159,25 +217,23 @@ private:
 	{
 		CheckLockOwnership( lock, &_registryMutex );
 
-		typedef typename SourceRegistry::value_type Item;
-		BOOST_FOREACH( Item & item, _registry )
+		BOOST_FOREACH( SourceRegistration& reg, _sources )
 		{
-			SourceRegistration& reg = item.second;
-			while( !reg.buffer.empty() && get_lowest_key( reg.buffer ) <= t )
+			while( !reg.buffer.Empty() && reg.buffer.Front().first <= t )
 			{
-				remove_lowest( reg.buffer );
+				reg.buffer.PopFront();
 			}
 		}
 	}
 
 
 	template<typename Lock>
-	void CheckStatus( const std::string& key, bool expect_reg,
-	                  const Lock& lock )
+	void CheckStatus( const Key& key, bool expect_reg,
+	                  const Lock& lock ) const
 	{
 		CheckLockOwnership( lock, &_registryMutex );
 
-		bool is_reg = _registry.count( key ) > 0;
+		bool is_reg = _indices.count( key ) > 0;
 		if( expect_reg != is_reg )
 		{
 			std::stringstream ss;
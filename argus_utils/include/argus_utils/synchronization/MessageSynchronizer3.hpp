@@ -1,33 +1,138 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <deque>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <vector>
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
 #include <Eigen/Dense>
 #include <sstream>
 #include <stdexcept>
 
+#include "argus_utils/synchronization/RingQueue.hpp"
 #include "argus_utils/synchronization/SynchronizationTypes.h"
-#include "argus_utils/utils/MapUtils.hpp"
+#include "argus_utils/synchronization/WorkerPool.h"
+#include "argus_utils/utils/IndexedHeap.hpp"
+#include "argus_utils/utils/InterpolationTraits.hpp"
+#include "argus_utils/utils/StampedRing.hpp"
 
 namespace argus
 {
 
 /*! \brief Synchronizes buffers of timestamped data within some amount of tolerance.
+ * Ingest is decoupled from matching: BufferData only pushes onto the
+ * source's lock-free inbound queue, found through an immutable registry
+ * snapshot, so producers never block on GetOutput. GetOutput moves queued
+ * data into the buffers of the sources that received any before matching.
+ * A repeated stamp replaces the previous datum, but still takes a queue slot
+ * until drained.
+ *
+ * Instead of polling GetOutput, a handler may be set with SetOutputHandler.
+ * Matching then runs on a WorkerPool as soon as data arrive, and each set is
+ * passed to the handler as soon as it completes. Data still unmatched when
+ * push mode ends are left in the buffers, and discarded on destruction.
+ *
+ * For types with InterpolationTraits, SetInterpolation switches to producing
+ * every source's value at one common reference stamp, interpolated between
+ * the data on either side of it, rather than the data closest to it.
+ * RegisterSource returns a SourceHandle, which BufferData takes to index the
+ * source directly. Calls by key look up the handle first.
+ *
  * NOTE: Accesses to the output buffer are synchronized, but parameter setting and registration
  * is not
  */
-template<typename Msg, typename Key = std::string>
+template<typename Msg, typename Key = std::string,
+         typename LockPolicy = DefaultLockPolicy>
 class MessageSynchronizer
 {
 public:
 
 	typedef std::tuple<Key, double, Msg> KeyedStampedData;
 
+	typedef typename LockPolicy::Mutex Mutex;
+	typedef typename LockPolicy::ReadLock ReadLock;
+	typedef typename LockPolicy::WriteLock WriteLock;
+
+	typedef boost::function<void( const std::vector<KeyedStampedData>& )> OutputHandler;
+
 	MessageSynchronizer()
+	: _registry( nullptr ), _dirty( nullptr ), _interpolate( false ),
+	  _referenceIndex( -1 ), _pushing( false ), _pool( nullptr ),
+	  _maxInFlight( 1 ), _matchScheduled( false ), _delivering( false ),
+	  _capped( false ), _numJobs( 0 )
 	{
 		SetBufferLength( 10 );
 		SetMaxDt( 0.1 );
 		SetMinSyncNum( 0 );
+		NameLock( _registryMutex, "MessageSynchronizer::registry" );
+		_snapshots.emplace_back( new Registry() );
+		_registry.store( _snapshots.back().get() );
+	}
+
+	/*! \brief Waits for sets being passed to the output handler. Data not
+	 * yet matched are discarded. Must not be called from the handler. */
+	~MessageSynchronizer()
+	{
+		ClearOutputHandler();
+	}
+
+	/*! \brief Switches to push mode, in which matching runs on the pool
+	 * whenever data arrive and each set is passed to the handler once
+	 * complete. Sets are passed one at a time, in time order. At most
+	 * maxInFlight sets may be matched but not yet handled; further data wait
+	 * in the buffers, which are still pruned to length. GetOutput should not
+	 * be called in push mode. The handler must not throw. The pool must have
+	 * been started, and not be stopped until the handler is cleared, or
+	 * ClearOutputHandler and the destructor wait forever. */
+	void SetOutputHandler( const OutputHandler& handler,
+	                       WorkerPool& pool = WorkerPool::Global(),
+	                       unsigned int maxInFlight = 4 )
+	{
+		if( maxInFlight == 0 )
+		{
+			throw std::invalid_argument( "Max sets in flight must be positive." );
+		}
+		if( pool.GetNumActiveWorkers() == 0 )
+		{
+			throw std::invalid_argument( "Output handler pool has no running workers." );
+		}
+
+		ClearOutputHandler();
+		_handler = handler;
+		_pool = &pool;
+		_maxInFlight = maxInFlight;
+		_matchScheduled.store( false );
+		_pushing.store( true );
+		ScheduleMatch();
+	}
+
+	/*! \brief Returns to polling mode after handling the sets already
+	 * matched. Blocks until the handler has returned. Data not yet matched
+	 * stay buffered for GetOutput. Throws std::logic_error if called from
+	 * the handler, which would wait on itself. */
+	void ClearOutputHandler()
+	{
+		{
+			WriteLock lock( _registryMutex );
+			if( _delivering && _handlerThread == boost::this_thread::get_id() )
+			{
+				throw std::logic_error( "Cannot clear the output handler from within it." );
+			}
+		}
+
+		_pushing.store( false );
+		boost::unique_lock<boost::mutex> lock( _jobsMutex );
+		while( _numJobs.load() > 0 ) { _jobsDone.wait( lock ); }
 	}
 
 	// NOTE Does not change buffer length of existing buffers!
@@ -50,26 +155,95 @@ public:
 		_minSyncNum = num;
 	}
 
-	void RegisterSource( const Key& key )
+	/*! \brief Enables interpolating mode, in which each set holds every
+	 * source's value at a reference stamp, interpolated from the source's
+	 * data on either side of it. Both must be within max dt of the stamp, so
+	 * max dt can be looser than when picking the closest data. A datum at
+	 * exactly the stamp is used as is. The min sync number is ignored. Throws
+	 * if Msg has no InterpolationTraits. */
+	void SetInterpolation( bool interp )
+	{
+		if( interp && !InterpolationTraits<Msg>::IsInterpolable )
+		{
+			throw std::invalid_argument( "Message type cannot be interpolated." );
+		}
+		_interpolate = interp;
+	}
+
+	/*! \brief In interpolating mode, uses only the stamps of the source as
+	 * reference stamps. Otherwise every stamp of every source is tried. */
+	void SetReferenceSource( const Key& key )
+	{
+		WriteLock lock( _registryMutex );
+		_referenceIndex = GetHandle( key ).index;
+	}
+
+	void ClearReferenceSource()
+	{
+		WriteLock lock( _registryMutex );
+		_referenceIndex = -1;
+	}
+
+	/*! \brief Registers a source and returns its handle. */
+	SourceHandle RegisterSource( const Key& key )
 	{
 		WriteLock lock( _registryMutex );
 		CheckStatus( key, false, lock );
-		_registry[key];
+
+		unsigned int index = _sources.size();
+		_sources.emplace_back( index, key, _bufferLen );
+		_earliestHeads.Resize( _sources.size() );
+		_latestHeads.Resize( _sources.size() );
+
+		// Producers may still be reading the old snapshot, so it is kept
+		Registry* registry = new Registry( *_registry.load() );
+		_snapshots.emplace_back( registry );
+		registry->sources[key] = &_sources.back();
+		registry->byIndex.push_back( &_sources.back() );
+		_registry.store( registry, std::memory_order_release );
+		return SourceHandle( index );
+	}
+
+	/*! \brief Returns the handle of a registered source. Throws if the
+	 * source is not registered. */
+	SourceHandle GetHandle( const Key& key ) const
+	{
+		const Registry& registry = *_registry.load( std::memory_order_acquire );
+		typename Registry::SourceMap::const_iterator iter = registry.sources.find( key );
+		if( iter == registry.sources.end() )
+		{
+			std::stringstream ss;
+			ss << "Source: " << key << " not registered!";
+			throw std::invalid_argument( ss.str() );
+		}
+		return SourceHandle( iter->second->index );
 	}
 
 	void BufferData( const Key& key,
 	                 double t,
 	                 const Msg& m )
 	{
-		ReadLock lock( _registryMutex );
-		CheckStatus( key, true, lock );
+		BufferData( GetHandle( key ), t, m );
+	}
 
-		SourceRegistration& reg = _registry.at( key );
-		WriteLock buffLock( reg.bufferMutex );
+	/*! \brief Queues data for the source without taking any locks. Throws
+	 * if the source is not registered or t precedes the last time buffered. */
+	void BufferData( SourceHandle handle,
+	                 double t,
+	                 const Msg& m )
+	{
+		const Registry& registry = *_registry.load( std::memory_order_acquire );
+		if( handle.index >= registry.byIndex.size() )
+		{
+			std::stringstream ss;
+			ss << "Source handle: " << handle.index << " not registered!";
+			throw std::invalid_argument( ss.str() );
+		}
+		Source& source = *registry.byIndex[handle.index];
 
-		if( !reg.buffer.empty() )
+		double lastTime = source.lastTime.load();
+		do
 		{
-			double lastTime = get_highest_key( reg.buffer );
 			if( t < lastTime )
 			{
 				std::stringstream ss;
@@ -77,16 +251,29 @@ public:
 				throw std::invalid_argument( ss.str() );
 			}
 		}
+		while( !source.lastTime.compare_exchange_weak( lastTime, t ) );
 
-		reg.buffer[t] = m;
+		source.inbound.EmplaceBack( t, m );
 
-		// Prune down to size
-		while( reg.buffer.size() > _bufferLen )
+		// Pairs with the fence in DrainInbound, so that either this data is
+		// drained or the source is flagged again
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		if( !source.flagged.exchange( true ) )
 		{
-			remove_lowest( reg.buffer );
+			Source* head = _dirty.load();
+			do
+			{
+				source.nextDirty = head;
+			}
+			while( !_dirty.compare_exchange_weak( head, &source ) );
+
+			if( _pushing.load() ) { ScheduleMatch(); }
 		}
 	}
 
+	/*! \brief Finds the earliest set of synchronized data and removes it from
+	 * the buffers. Each attempt costs O(log K) for K sources, plus O(log K)
+	 * per message returned or trimmed. Data are ordered by registration. */
 	bool GetOutput( std::vector<KeyedStampedData>& out )
 	{
 		out.clear();
@@ -95,91 +282,409 @@ public:
 		WriteLock lock( _registryMutex );
 
 		// Quick fail if we have nothing to check!
-		if( _registry.size() == 0 ) { return false; }
+		if( _sources.size() == 0 ) { return false; }
 
-		while( !AnyBuffersEmpty( lock ) )
+		DrainInbound( lock );
+		return FindOutput( out, lock );
+	}
+
+	/*! \brief Extracts every ready synchronized set under one lock, in time
+	 * order. Returns whether there were any. */
+	bool GetAllOutputs( std::vector< std::vector<KeyedStampedData> >& outs )
+	{
+		outs.clear();
+		WriteLock lock( _registryMutex );
+		if( _sources.size() == 0 ) { return false; }
+
+		DrainInbound( lock );
+		while( true )
 		{
-			double earliest = GetEarliestTime( lock );
-			if( EnoughContain( earliest, lock ) )
+			outs.emplace_back();
+			if( !FindOutput( outs.back(), lock ) )
 			{
-				RetrieveAndRemoveData( earliest, out, lock );
-				// Don't remove b/c there may be more synchronized sets
-				return true;
-			}
-			else
-			{
-				// Trim off all data up to and including, and try again
-				RemoveBeforeInclusive( earliest, lock );
+				outs.pop_back();
+				return !outs.empty();
 			}
 		}
-		return false;
 	}
 
 private:
 
-	struct SourceRegistration
+	typedef std::pair<double, Msg> StampedData;
+
+	struct Source
+	{
+		unsigned int index;
+		Key key;
+		unsigned int bufferLen;
+		StampedRing<Msg> buffer; // Only accessed by the matcher
+		StampedData prev; // Last datum removed from the buffer
+		bool hasPrev;
+
+		RingQueue<StampedData> inbound;
+		std::atomic<double> lastTime; // Latest time queued
+		std::atomic<bool> flagged; // In the dirty list
+		Source* nextDirty;
+
+		Source( unsigned int ind, const Key& k, unsigned int len )
+		: index( ind ), key( k ), bufferLen( len ), buffer( std::max( len, 1u ) ),
+		  hasPrev( false ), inbound( std::max( len, 1u ) ),
+		  lastTime( -std::numeric_limits<double>::infinity() ),
+		  flagged( false ), nextDirty( nullptr ) {}
+	};
+
+	/*! \brief An immutable lookup from keys and handles to sources for
+	 * producers. */
+	struct Registry
 	{
-		mutable Mutex bufferMutex;
-		std::map<double, Msg> buffer;
+		typedef std::map<Key, Source*> SourceMap;
+		SourceMap sources;
+		std::vector<Source*> byIndex;
 	};
 
-	typedef std::map<Key, SourceRegistration> SourceRegistry;
-	mutable Mutex _registryMutex; // Locks all access to the registry
-	SourceRegistry _registry;
+	mutable Mutex _registryMutex; // Serializes registration and matching
+	std::deque<Source> _sources; // Does not move sources
+	std::vector< std::unique_ptr<Registry> > _snapshots; // Current is last
+	std::atomic<const Registry*> _registry;
+	std::atomic<Source*> _dirty; // Sources with queued data, linked by nextDirty
+
+	// Heads of the non-empty buffers, ordered both ways. Since every buffer
+	// is sorted, the earliest head is the earliest time buffered, and the
+	// closest datum to it in any buffer is that buffer's head.
+	IndexedHeap< std::less<double> > _earliestHeads;
+	IndexedHeap< std::greater<double> > _latestHeads;
+	std::vector<unsigned int> _synced; // Reused by RetrieveAndRemoveData
 
 	// Parameters
 	unsigned int _bufferLen;
 	double _maxDt;
 	unsigned int _minSyncNum;
+	bool _interpolate;
+	int _referenceIndex; // Negative for none
+
+	// Push mode. Matched sets wait in _ready, guarded by _registryMutex,
+	// and are delivered by a single job at a time to keep them in order
+	std::atomic<bool> _pushing;
+	OutputHandler _handler;
+	WorkerPool* _pool;
+	unsigned int _maxInFlight;
+	std::atomic<bool> _matchScheduled;
+	std::deque< std::vector<KeyedStampedData> > _ready;
+	bool _delivering;
+	boost::thread::id _handlerThread; // Running DeliverJob, while delivering
+	bool _capped; // Matching stopped at the in-flight limit
+	std::atomic<unsigned int> _numJobs; // Submitted and not finished
+	boost::mutex _jobsMutex;
+	boost::condition_variable _jobsDone;
+
+	/*! \brief Submits a matching job unless one is already waiting to run. */
+	void ScheduleMatch()
+	{
+		if( _matchScheduled.exchange( true ) ) { return; }
+		SubmitJob( boost::bind( &MessageSynchronizer::MatchJob, this ), false );
+	}
 
-	bool AnyBuffersEmpty( const WriteLock& lock ) const
+	/*! \brief Submits a job unless push mode was left. Jobs may always submit
+	 * follow-ups, since ClearOutputHandler is still waiting on them. */
+	void SubmitJob( const WorkerPool::Job& job, bool fromJob )
+	{
+		// Counted before checking, so ClearOutputHandler cannot miss the job
+		++_numJobs;
+		if( !fromJob && !_pushing.load() )
+		{
+			FinishJob();
+			return;
+		}
+		_pool->EnqueueJob( job );
+	}
+
+	/*! \brief Counts a job as done. Decrements under the lock, so that a
+	 * waiter cannot see zero and destroy this before the job lets go. */
+	void FinishJob()
+	{
+		boost::unique_lock<boost::mutex> lock( _jobsMutex );
+		if( --_numJobs == 0 ) { _jobsDone.notify_all(); }
+	}
+
+	/*! \brief Matches sets up to the in-flight limit and starts delivery. */
+	void MatchJob()
+	{
+		// Cleared before draining, so data queued after the drain schedule again
+		_matchScheduled.store( false );
+		if( !_pushing.load() )
+		{
+			FinishJob();
+			return;
+		}
+
+		{
+			WriteLock lock( _registryMutex );
+			DrainInbound( lock );
+
+			unsigned int inFlight = _ready.size() + ( _delivering ? 1 : 0 );
+			_capped = false;
+			while( true )
+			{
+				if( inFlight >= _maxInFlight )
+				{
+					_capped = true;
+					break;
+				}
+				_ready.emplace_back();
+				if( !FindOutput( _ready.back(), lock ) )
+				{
+					_ready.pop_back();
+					break;
+				}
+				++inFlight;
+			}
+
+			if( !_ready.empty() && !_delivering )
+			{
+				_delivering = true;
+				SubmitJob( boost::bind( &MessageSynchronizer::DeliverJob, this ), true );
+			}
+		}
+		FinishJob();
+	}
+
+	/*! \brief Passes ready sets to the handler in order until none are left. */
+	void DeliverJob()
+	{
+		std::vector<KeyedStampedData> set;
+		bool capped;
+		while( true )
+		{
+			{
+				WriteLock lock( _registryMutex );
+				if( _ready.empty() )
+				{
+					_delivering = false;
+					_handlerThread = boost::thread::id();
+					capped = _capped;
+					break;
+				}
+				set.swap( _ready.front() );
+				_ready.pop_front();
+				_handlerThread = boost::this_thread::get_id();
+			}
+			_handler( set );
+		}
+
+		// Sets held back by the limit can go now
+		if( capped && !_matchScheduled.exchange( true ) )
+		{
+			SubmitJob( boost::bind( &MessageSynchronizer::MatchJob, this ), true );
+		}
+		FinishJob();
+	}
+
+	/*! \brief Moves queued data into the buffers of flagged sources. Since
+	 * the inbound queues hold as many data as the buffers, data dropped from
+	 * a full queue would have been pruned from the buffer anyway. */
+	void DrainInbound( const WriteLock& lock )
 	{
 		CheckLockOwnership( lock, &_registryMutex );
 
-		typedef typename SourceRegistry::value_type Item;
-		BOOST_FOREACH( const Item &item, _registry )
+		Source* source = _dirty.exchange( nullptr );
+		StampedData item;
+		while( source )
+		{
+			Source* next = source->nextDirty;
+			source->flagged.store( false );
+			std::atomic_thread_fence( std::memory_order_seq_cst );
+
+			bool headChanged = false;
+			while( source->inbound.TryPopFront( item ) )
+			{
+				headChanged |= Append( *source, item );
+			}
+			if( headChanged ) { UpdateHead( source->index ); }
+			source = next;
+		}
+	}
+
+	/*! \brief Appends to a source buffer, pruning it to length. Returns
+	 * whether the head of the buffer changed. */
+	bool Append( Source& source, StampedData& item )
+	{
+		StampedRing<Msg>& buffer = source.buffer;
+		bool headChanged = buffer.Empty();
+		if( !buffer.Empty() )
+		{
+			// Concurrent producers for one source may queue out of order
+			double lastTime = buffer.Back().first;
+			if( item.first < lastTime ) { return false; }
+			if( item.first == lastTime )
+			{
+				buffer.Back().second = std::move( item.second );
+				return false;
+			}
+		}
+
+		// Prune down to size before appending, so the ring never grows
+		while( !buffer.Empty() && buffer.Size() >= source.bufferLen )
+		{
+			PopHead( source );
+			headChanged = true;
+		}
+		if( source.bufferLen > 0 )
 		{
-			const SourceRegistration& reg = item.second;
-			if( reg.buffer.empty() ) { return true; }
+			buffer.PushBack( item.first, std::move( item.second ) );
+		}
+		return headChanged;
+	}
+
+	/*! \brief Removes the earliest synchronized set from the buffers into out,
+	 * trimming data that cannot be synchronized on the way. */
+	bool FindOutput( std::vector<KeyedStampedData>& out, const WriteLock& lock )
+	{
+		CheckLockOwnership( lock, &_registryMutex );
+
+		if( _interpolate ) { return FindInterpolated( out, lock ); }
+
+		while( !AnyBuffersEmpty( lock ) )
+		{
+			double earliest = _earliestHeads.TopKey();
+			if( EnoughContain( earliest, lock ) )
+			{
+				RetrieveAndRemoveData( earliest, out, lock );
+				// Don't remove b/c there may be more synchronized sets
+				return true;
+			}
+			else
+			{
+				// Trim off all data up to and including, and try again
+				RemoveBeforeInclusive( earliest, lock );
+			}
 		}
 		return false;
 	}
 
-	double GetEarliestTime( const WriteLock& lock ) const
+	/*! \brief Produces the earliest interpolated set into out. Reference
+	 * stamps are tried in time order at the earliest head, and the heads at
+	 * each are kept as the sources' previous data afterwards. Since all other
+	 * heads are later, a source's data on either side of the stamp are its
+	 * previous datum and its head, which later data cannot improve on. */
+	bool FindInterpolated( std::vector<KeyedStampedData>& out, const WriteLock& lock )
 	{
 		CheckLockOwnership( lock, &_registryMutex );
 
-		typedef typename SourceRegistry::value_type Item;
-		double earliest = std::numeric_limits<double>::infinity();
-		BOOST_FOREACH( const Item &item, _registry )
+		while( !AnyBuffersEmpty( lock ) )
 		{
-			const SourceRegistration& reg = item.second;
-			double buffEarliest = get_lowest_key( reg.buffer );
-			if( buffEarliest < earliest )
+			double t = _earliestHeads.TopKey();
+			bool ready = CanInterpolate( t, lock );
+			if( ready )
+			{
+				BOOST_FOREACH( Source& reg, _sources )
+				{
+					out.push_back( KeyedStampedData( reg.key, t, ValueAt( reg, t ) ) );
+				}
+			}
+
+			while( !_earliestHeads.Empty() && _earliestHeads.TopKey() <= t )
 			{
-				earliest = buffEarliest;
+				unsigned int index = _earliestHeads.Top();
+				PopHead( _sources[index] );
+				UpdateHead( index );
 			}
+			if( ready ) { return true; }
 		}
-		return earliest;
+		return false;
 	}
 
-	bool EnoughContain( double t, const WriteLock& lock )
+	/*! \brief Returns whether every source can be evaluated at t, the
+	 * earliest head. Rejects on the latest head in O(1), and otherwise checks
+	 * each source's previous datum in O(K). */
+	bool CanInterpolate( double t, const WriteLock& lock ) const
 	{
 		CheckLockOwnership( lock, &_registryMutex );
 
-		typename std::map<double, Msg>::const_iterator iter;
-		typedef typename SourceRegistry::value_type Item;
-		unsigned int count = 0;
-		BOOST_FOREACH( const Item &item, _registry )
+		if( _referenceIndex >= 0 && _sources[_referenceIndex].buffer.Front().first != t )
 		{
-			const SourceRegistration& reg = item.second;
-			if( !get_closest_eq( reg.buffer, t, iter ) ) { continue; }
-			double closest = iter->first;
-			if( std::abs( closest - t ) <= _maxDt ) { ++count; }
+			return false;
 		}
+		if( _latestHeads.TopKey() - t > _maxDt ) { return false; }
 
-		if( _minSyncNum == 0 ) { return count == _registry.size(); }
-		else { return count >= _minSyncNum; }
+		BOOST_FOREACH( const Source& reg, _sources )
+		{
+			if( reg.buffer.Front().first == t ) { continue; }
+			if( !reg.hasPrev || t - reg.prev.first > _maxDt ) { return false; }
+		}
+		return true;
+	}
+
+	/*! \brief Returns the value of a source at t, which lies between its
+	 * previous datum and its head. */
+	Msg ValueAt( const Source& reg, double t ) const
+	{
+		const typename StampedRing<Msg>::value_type& head = reg.buffer.Front();
+		if( head.first == t ) { return head.second; }
+
+		double alpha = ( t - reg.prev.first ) / ( head.first - reg.prev.first );
+		return InterpolationTraits<Msg>::Interpolate( reg.prev.second, head.second, alpha );
+	}
+
+	/*! \brief Removes the head of a buffer, keeping it as the previous datum.
+	 * Swaps rather than copies, so the freed slot reuses the old one. */
+	void PopHead( Source& reg )
+	{
+		std::swap( reg.prev, reg.buffer.Front() );
+		reg.hasPrev = true;
+		reg.buffer.PopFront();
+	}
+
+	/*! \brief Updates the heaps after the head of a buffer changes. */
+	void UpdateHead( unsigned int index )
+	{
+		const Source& reg = _sources[index];
+		if( reg.buffer.Empty() )
+		{
+			_earliestHeads.Remove( index );
+			_latestHeads.Remove( index );
+		}
+		else
+		{
+			double head = reg.buffer.Front().first;
+			_earliestHeads.Set( index, head );
+			_latestHeads.Set( index, head );
+		}
+	}
+
+	bool AnyBuffersEmpty( const WriteLock& lock ) const
+	{
+		CheckLockOwnership( lock, &_registryMutex );
+		return _earliestHeads.Size() < _sources.size();
+	}
+
+	/*! \brief Returns whether enough buffers have a datum within max dt of t,
+	 * the earliest head. All K must, unless a min sync number is set, which
+	 * reduces to checking the latest head. Otherwise costs O(min sync num). */
+	bool EnoughContain( double t, const WriteLock& lock ) const
+	{
+		CheckLockOwnership( lock, &_registryMutex );
+
+		if( _minSyncNum == 0 )
+		{
+			return _latestHeads.TopKey() - t <= _maxDt;
+		}
+		return _earliestHeads.CountUpTo( SyncBound( t ), _minSyncNum ) >= _minSyncNum;
+	}
+
+	/*! \brief Returns the latest time within max dt of t, rounded so that
+	 * comparing against it agrees with comparing differences to max dt. */
+	double SyncBound( double t ) const
+	{
+		const double inf = std::numeric_limits<double>::infinity();
+		double bound = t + _maxDt;
+		// Every time is within an infinite max dt, and stepping would not end
+		if( !std::isfinite( bound ) ) { return inf; }
+		while( bound - t > _maxDt ) { bound = std::nextafter( bound, -inf ); }
+		while( std::nextafter( bound, inf ) - t <= _maxDt )
+		{
+			bound = std::nextafter( bound, inf );
+		}
+		return bound;
 	}
 
 	void RetrieveAndRemoveData( double t,
@@ -188,18 +693,16 @@ private:
 	{
 		CheckLockOwnership( lock, &_registryMutex );
 
-		typename std::map<double, Msg>::const_iterator iter;
-		typedef typename SourceRegistry::value_type Item;
-		BOOST_FOREACH( Item & item, _registry )
+		_synced.clear();
+		_earliestHeads.FindUpTo( SyncBound( t ), _synced );
+		std::sort( _synced.begin(), _synced.end() );
+		BOOST_FOREACH( unsigned int index, _synced )
 		{
-			const Key& key = item.first;
-			SourceRegistration& reg = item.second;
-			if( !get_closest_eq( reg.buffer, t, iter ) ) { continue; }
-			double closest = iter->first;
-			if( std::abs( closest - t ) > _maxDt ) { continue; }
-
-			out.push_back( KeyedStampedData( key, iter->first, iter->second ) );
-			reg.buffer.erase( iter );
+			Source& reg = _sources[index];
+			const typename StampedRing<Msg>::value_type& head = reg.buffer.Front();
+			out.push_back( KeyedStampedData( reg.key, head.first, head.second ) );
+			PopHead( reg );
+			UpdateHead( index );
 		}
 	}
 
@@ -208,25 +711,26 @@ private:
 	{
 		CheckLockOwnership( lock, &_registryMutex );
 
-		typedef typename SourceRegistry::value_type Item;
-		BOOST_FOREACH( Item & item, _registry )
+		while( !_earliestHeads.Empty() && _earliestHeads.TopKey() <= t )
 		{
-			SourceRegistration& reg = item.second;
-			while( !reg.buffer.empty() && get_lowest_key( reg.buffer ) <= t )
+			unsigned int index = _earliestHeads.Top();
+			Source& reg = _sources[index];
+			while( !reg.buffer.Empty() && reg.buffer.Front().first <= t )
 			{
-				remove_lowest( reg.buffer );
+				PopHead( reg );
 			}
+			UpdateHead( index );
 		}
 	}
 
 
 	template<typename Lock>
-	void CheckStatus( const std::string& key, bool expect_reg,
+	void CheckStatus( const Key& key, bool expect_reg,
 	                  const Lock& lock )
 	{
 		CheckLockOwnership( lock, &_registryMutex );
 
-		bool is_reg = _registry.count( key ) > 0;
+		bool is_reg = _registry.load()->sources.count( key ) > 0;
 		if( expect_reg != is_reg )
 		{
 			std::stringstream ss;
@@ -2,6 +2,9 @@
 
 #include <deque>
 #include <cmath>
+#include <map>
+#include <sstream>
+#include <vector>
 #include <boost/foreach.hpp>
 #include <boost/circular_buffer.hpp>
 #include <boost/random/mersenne_twister.hpp>
@@ -13,21 +16,28 @@ namespace argus
 {
 
 /*! \brief Weighted subsampling and delaying of message streams to 
- * achieve a target message rate. 
+ * achieve a target message rate. RegisterSource returns a SourceHandle,
+ * which the per-message calls take to index the source directly.
  * // NOTE Accessing outputs is synchronized, but setting parameters is not!
  */
- template <typename Msg, typename Key = std::string>
+ template <typename Msg, typename Key = std::string,
+           typename LockPolicy = DefaultLockPolicy>
  class MessageThrottler
  {
 public:
 
     typedef std::pair<Key, Msg> KeyedData;
 
+    typedef typename LockPolicy::Mutex Mutex;
+    typedef typename LockPolicy::ReadLock ReadLock;
+    typedef typename LockPolicy::WriteLock WriteLock;
+
     MessageThrottler() 
     {
         SetTargetRate( 10.0 );
         SetMinRate( 0.0 );
         SetBufferLength( 10 );
+        NameLock( _mutex, "MessageThrottler::outputs" );
     }
 
     void SetMinRate( double min )
@@ -53,82 +63,98 @@ public:
 
     void SetBufferLength( unsigned int buffLen )
     {
-        if( buffLen != _bufferLen && _registry.size() > 0 )
+        if( buffLen != _bufferLen && _sources.size() > 0 )
         {
             std::cerr << "Warning: Changing buffer length does not modify existing buffers." << std::endl;
         }
         _bufferLen = buffLen;
     }
 
-    void RegisterSource( const Key& key )
+    /*! \brief Registers a source and returns its handle. */
+    SourceHandle RegisterSource( const Key& key )
     {
         CheckStatus( key, false );
-        _registry.emplace( std::piecewise_construct,
-                           std::forward_as_tuple( key ), 
-                           std::forward_as_tuple( _bufferLen ) );
+        unsigned int index = _sources.size();
+        _sources.emplace_back( key, _bufferLen );
+        _indices[key] = index;
         ComputeBufferRates();
+        return SourceHandle( index );
     }
 
-    void SetSourceWeight( const Key& key, double w )
+    /*! \brief Returns the handle of a registered source. Throws if the
+     * source is not registered. */
+    SourceHandle GetHandle( const Key& key ) const
     {
         CheckStatus( key, true );
+        return SourceHandle( _indices.at( key ) );
+    }
+
+    void SetSourceWeight( const Key& key, double w )
+    {
+        SetSourceWeight( GetHandle( key ), w );
+    }
+
+    void SetSourceWeight( SourceHandle handle, double w )
+    {
         if( w < 0 )
         {
             throw std::invalid_argument( "Weights must be positive." );
         }
-        _registry.at( key ).SetWeight( w );
+        GetSource( handle ).SetWeight( w );
         ComputeBufferRates();
     }
 
     void BufferData( const Key& key,
                      const Msg& m )
     {
-        CheckStatus( key, true );
-        _registry.at( key ).Buffer( m );
+        BufferData( GetHandle( key ), m );
     }
 
-    bool GetOutput( double now, KeyedData& out )
+    void BufferData( SourceHandle handle,
+                     const Msg& m )
     {
-        typedef typename SourceRegistry::value_type Item;
+        GetSource( handle ).Buffer( m );
+    }
 
+    bool GetOutput( double now, KeyedData& out )
+    {
         WriteLock outlock( _mutex );
 
-        if( _registry.size() == 0 ) { return false; }
+        if( _sources.size() == 0 ) { return false; }
 
-        std::vector<Key> keys;
-        std::vector<double> scores;
-        BOOST_FOREACH( const Item& item, _registry )
+        // Sources with the most to output, reused across calls
+        double maxScore = 0;
+        _maxIndices.clear();
+        for( unsigned int i = 0; i < _sources.size(); ++i )
         {
-            keys.push_back( item.first );
-            scores.push_back( item.second.ComputeNumToOutput( now ) );
+            double score = _sources[i].ComputeNumToOutput( now );
+            if( score > maxScore )
+            {
+                maxScore = score;
+                _maxIndices.clear();
+            }
+            if( score == maxScore && score > 0 ) { _maxIndices.push_back( i ); }
         }
         
         // If no scores were nonzero, there are no outputs to be had!
-        double maxScore = *std::max_element( scores.begin(), scores.end() );
-        if( maxScore == 0 )
+        if( _maxIndices.empty() )
         {
             return false;
         }
 
-        std::vector<Key> maxKeys;
-        for( unsigned int i = 0; i < scores.size(); ++i )
-        {
-            if( scores[i] == maxScore ) { maxKeys.push_back( keys[i] ); }
-        }
-
-        std::string maxKey;
-        if( maxKeys.size() == 1 )
+        unsigned int maxIndex;
+        if( _maxIndices.size() == 1 )
         {
-            maxKey = maxKeys[0];
+            maxIndex = _maxIndices[0];
         }
         else
         {
-            boost::random::uniform_int_distribution<> tiebreak( 0, maxKeys.size()-1 );
-            maxKey = maxKeys[tiebreak(_randGen)];
+            boost::random::uniform_int_distribution<> tiebreak( 0, _maxIndices.size()-1 );
+            maxIndex = _maxIndices[tiebreak(_randGen)];
         }
 
-        Msg m = _registry.at( maxKey ).PopAndMark( now );
-        out = KeyedData( maxKey, m );
+        SourceRegistration& reg = _sources[maxIndex];
+        out = KeyedData( reg.key, reg.PopAndMark( now ) );
         return true;
     }
 
@@ -137,34 +163,31 @@ private:
     // Compute the bandwidth allocations for each buffer
     void ComputeBufferRates()
     {
-        typedef typename SourceRegistry::value_type Item;
-
-        double assignableRate = _overallRate - _registry.size() * _minRate;
+        double assignableRate = _overallRate - _sources.size() * _minRate;
         double effectiveMin = _minRate;
         if( assignableRate < 0 )
         {
-            std::cerr << "Warning: min rate " << _minRate << " with " << _registry.size()
+            std::cerr << "Warning: min rate " << _minRate << " with " << _sources.size()
                       << " sources exceeds overall rate " << _overallRate << std::endl;
-            effectiveMin = _overallRate / _registry.size();
+            effectiveMin = _overallRate / _sources.size();
             assignableRate = 0;
         }
 
         double sumWeights = 0;
-        BOOST_FOREACH( const Item& item, _registry )
+        BOOST_FOREACH( const SourceRegistration& reg, _sources )
         {
-            sumWeights += item.second.weight;
+            sumWeights += reg.weight;
         }
         if( sumWeights == 0 ) { sumWeights = 1.0; }
-        BOOST_FOREACH( Item& item, _registry )
+        BOOST_FOREACH( SourceRegistration& reg, _sources )
         {
-            SourceRegistration& reg = item.second;
             reg.rate = assignableRate * reg.weight / sumWeights + effectiveMin;
         }
     }
 
-    void CheckStatus( const std::string& key, bool expect_reg )
+    void CheckStatus( const Key& key, bool expect_reg ) const
     {
-        bool is_reg = _registry.count( key ) > 0;
+        bool is_reg = _indices.count( key ) > 0;
         if( expect_reg != is_reg )
         {
             std::stringstream ss;
@@ -176,15 +199,19 @@ private:
     // TODO Clean up public/private here
     struct SourceRegistration
     {
+        Key key;
         mutable Mutex mutex;
         boost::circular_buffer<Msg> buffer;
         double weight;
         double rate;
         double lastOutputTime;
 
-        SourceRegistration( unsigned int len )
-        : mutex(), buffer( len ), weight( 0 ), rate( 0 ),
-          lastOutputTime( -std::numeric_limits<double>::infinity() ) {}
+        SourceRegistration( const Key& k, unsigned int len )
+        : key( k ), mutex(), buffer( len ), weight( 0 ), rate( 0 ),
+          lastOutputTime( -std::numeric_limits<double>::infinity() )
+        {
+            NameLock( mutex, "MessageThrottler::source" );
+        }
 
         double ComputeNumToOutput( double now ) const
         {
@@ -224,12 +251,24 @@ private:
         }
     };
 
+    SourceRegistration& GetSource( SourceHandle handle )
+    {
+        if( handle.index >= _sources.size() )
+        {
+            std::stringstream ss;
+            ss << "Source handle: " << handle.index << " not registered!";
+            throw std::invalid_argument( ss.str() );
+        }
+        return _sources[handle.index];
+    }
+
     mutable Mutex _mutex;
 
     boost::mt19937 _randGen;
 
-    typedef std::map<Key, SourceRegistration> SourceRegistry;
-    SourceRegistry _registry;
+    std::deque<SourceRegistration> _sources; // Indexed by handle
+    std::map<Key, unsigned int> _indices;
+    std::vector<unsigned int> _maxIndices; // Reused by GetOutput
 
     double _lastOutput;
     std::deque<KeyedData> _outputBuffer;
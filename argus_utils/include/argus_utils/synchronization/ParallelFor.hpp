@@ -0,0 +1,214 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "argus_utils/synchronization/WorkerPool.h"
+
+namespace argus
+{
+
+/*! \brief Tracks the chunks of a single ParallelFor or ParallelReduce call.
+ * Chunks are claimed from a shared counter by the calling thread and any
+ * pool workers that pick up a helper job, so the call completes even if
+ * every worker is busy, and waits only on its own chunks. */
+template <typename ChunkFunc>
+class ParallelBatch
+{
+public:
+
+	typedef std::shared_ptr<ParallelBatch> Ptr;
+
+	ParallelBatch( size_t begin, size_t end, size_t grain, const ChunkFunc& func )
+	: _begin( begin ), _end( end ), _grain( grain ),
+	  _numChunks( ( end - begin + grain - 1 ) / grain ),
+	  _nextChunk( 0 ), _doneChunks( 0 ), _failed( false ), _func( func ) {}
+
+	size_t NumChunks() const
+	{
+		return _numChunks;
+	}
+
+	/*! \brief Claims and runs chunks until none are left. */
+	void RunChunks()
+	{
+		size_t chunk;
+		while( ( chunk = _nextChunk.fetch_add( 1 ) ) < _numChunks )
+		{
+			if( !_failed.load() )
+			{
+				size_t cBegin = _begin + chunk * _grain;
+				size_t cEnd = std::min( cBegin + _grain, _end );
+				try
+				{
+					_func( chunk, cBegin, cEnd );
+				}
+				catch( ... )
+				{
+					Lock lock( _mutex );
+					if( !_failed.exchange( true ) )
+					{
+						_error = std::current_exception();
+					}
+				}
+			}
+
+			if( ++_doneChunks == _numChunks )
+			{
+				Lock lock( _mutex );
+				_done.notify_all();
+			}
+		}
+	}
+
+	/*! \brief Blocks until all chunks are done, then rethrows the first
+	 * exception raised by a chunk, if any. */
+	void Wait()
+	{
+		Lock lock( _mutex );
+		while( _doneChunks.load() < _numChunks )
+		{
+			_done.wait( lock );
+		}
+		if( _error ) { std::rethrow_exception( _error ); }
+	}
+
+	/*! \brief Runs the batch on the pool and the calling thread. */
+	static void Execute( WorkerPool& pool, const Ptr& batch )
+	{
+		// The caller runs chunks too, so one fewer helper is needed
+		size_t numHelpers = std::min<size_t>( pool.GetNumWorkers(),
+		                                      batch->NumChunks() - 1 );
+		for( size_t i = 0; i < numHelpers; ++i )
+		{
+			pool.EnqueueJob( boost::bind( &ParallelBatch::RunChunks, batch ) );
+		}
+		batch->RunChunks();
+		batch->Wait();
+	}
+
+private:
+
+	typedef boost::unique_lock<boost::mutex> Lock;
+
+	const size_t _begin;
+	const size_t _end;
+	const size_t _grain;
+	const size_t _numChunks;
+
+	std::atomic<size_t> _nextChunk;
+	std::atomic<size_t> _doneChunks;
+	std::atomic<bool> _failed;
+	std::exception_ptr _error;
+
+	boost::mutex _mutex;
+	boost::condition_variable _done;
+
+	ChunkFunc _func;
+};
+
+/*! \brief Picks a grain size giving a few chunks per worker, so that uneven
+ * chunk costs still balance out. */
+inline size_t ParallelGrainSize( const WorkerPool& pool, size_t begin, size_t end )
+{
+	size_t num = end - begin;
+	size_t targetChunks = 4 * std::max<unsigned int>( pool.GetNumWorkers(), 1 );
+	return std::max<size_t>( ( num + targetChunks - 1 ) / targetChunks, 1 );
+}
+
+template <typename Func>
+struct ParallelForChunk
+{
+	Func func;
+
+	ParallelForChunk( const Func& f ) : func( f ) {}
+
+	void operator()( size_t chunk, size_t begin, size_t end )
+	{
+		for( size_t i = begin; i < end; ++i ) { func( i ); }
+	}
+};
+
+/*! \brief Calls func( i ) for every i in [begin, end) using the pool and the
+ * calling thread, and returns once all calls have finished. Indices are
+ * split into chunks of grain indices, or an automatic size if grain is 0.
+ * Rethrows the first exception thrown by func. */
+template <typename Func>
+void ParallelFor( WorkerPool& pool, size_t begin, size_t end, size_t grain,
+                  const Func& func )
+{
+	if( end <= begin ) { return; }
+	if( grain == 0 ) { grain = ParallelGrainSize( pool, begin, end ); }
+
+	typedef ParallelBatch< ParallelForChunk<Func> > Batch;
+	typename Batch::Ptr batch = std::make_shared<Batch>( begin, end, grain,
+	                                                     ParallelForChunk<Func>( func ) );
+	Batch::Execute( pool, batch );
+}
+
+/*! \brief Runs ParallelFor on the global pool. */
+template <typename Func>
+void ParallelFor( size_t begin, size_t end, size_t grain, const Func& func )
+{
+	ParallelFor( WorkerPool::Global(), begin, end, grain, func );
+}
+
+template <typename T, typename Map, typename Reduce>
+struct ParallelReduceChunk
+{
+	T identity;
+	Map map;
+	Reduce reduce;
+	std::vector<T>* results;
+
+	ParallelReduceChunk( const T& i, const Map& m, const Reduce& r,
+	                     std::vector<T>* res )
+	: identity( i ), map( m ), reduce( r ), results( res ) {}
+
+	void operator()( size_t chunk, size_t begin, size_t end )
+	{
+		T acc = identity;
+		for( size_t i = begin; i < end; ++i ) { acc = reduce( acc, map( i ) ); }
+		( *results )[chunk] = acc;
+	}
+};
+
+/*! \brief Computes reduce( ... reduce( identity, map( begin ) ) ..., map( end-1 ) )
+ * in parallel. Each chunk is reduced separately and the chunk results are
+ * then combined in index order on the calling thread, so the result is
+ * deterministic whenever reduce is associative. */
+template <typename T, typename Map, typename Reduce>
+T ParallelReduce( WorkerPool& pool, size_t begin, size_t end, size_t grain,
+                  const T& identity, const Map& map, const Reduce& reduce )
+{
+	if( end <= begin ) { return identity; }
+	if( grain == 0 ) { grain = ParallelGrainSize( pool, begin, end ); }
+
+	std::vector<T> results( ( end - begin + grain - 1 ) / grain, identity );
+	typedef ParallelReduceChunk<T, Map, Reduce> Chunk;
+	typedef ParallelBatch<Chunk> Batch;
+	typename Batch::Ptr batch = std::make_shared<Batch>( begin, end, grain,
+	                                                     Chunk( identity, map, reduce, &results ) );
+	Batch::Execute( pool, batch );
+
+	T acc = identity;
+	for( size_t i = 0; i < results.size(); ++i ) { acc = reduce( acc, results[i] ); }
+	return acc;
+}
+
+/*! \brief Runs ParallelReduce on the global pool. */
+template <typename T, typename Map, typename Reduce>
+T ParallelReduce( size_t begin, size_t end, size_t grain,
+                  const T& identity, const Map& map, const Reduce& reduce )
+{
+	return ParallelReduce( WorkerPool::Global(), begin, end, grain, identity, map, reduce );
+}
+
+}
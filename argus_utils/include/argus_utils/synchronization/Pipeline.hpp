@@ -0,0 +1,415 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+#include <boost/chrono.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "argus_utils/synchronization/ThreadsafeQueue.hpp"
+#include "argus_utils/synchronization/WorkerPool.h"
+
+namespace argus
+{
+
+/*! \brief A snapshot of a pipeline stage's metrics since the last reset.
+ * Times are in seconds. */
+struct StageStatistics
+{
+	std::string name;
+	unsigned int numThreads;
+	unsigned long numProcessed; // Items passed on to the output
+	unsigned long numFiltered;  // Items the stage function rejected
+	double throughput;          // Items processed per second
+	double meanLatency;         // From entering the stage queue to output
+	double meanProcessTime;
+	double utilization;         // Busy fraction of the stage threads
+	QueueStatistics queue;
+
+	StageStatistics()
+	: numThreads( 0 ), numProcessed( 0 ), numFiltered( 0 ), throughput( 0 ),
+	  meanLatency( 0 ), meanProcessTime( 0 ), utilization( 0 ) {}
+};
+
+/*! \brief The untyped interface to a pipeline stage. */
+class PipelineStage
+{
+public:
+
+	typedef std::shared_ptr<PipelineStage> Ptr;
+
+	PipelineStage( const std::string& name ) : _name( name ) {}
+	virtual ~PipelineStage() {}
+
+	const std::string& GetName() const { return _name; }
+
+	/*! \brief Sets the number of threads running the stage. Takes effect at
+	 * the next call to Start(). */
+	virtual void SetNumThreads( unsigned int n ) = 0;
+
+	/*! \brief Starts the stage threads. */
+	virtual void Start() = 0;
+
+	/*! \brief Unblocks anything waiting on the stage and joins its threads.
+	 * Queued items are discarded, and a stopped stage cannot be restarted. */
+	virtual void Stop() = 0;
+
+	/*! \brief Blocks until every item pushed so far has been output. */
+	virtual void WaitIdle() = 0;
+
+	virtual StageStatistics GetStatistics() const = 0;
+	virtual void ResetStatistics() = 0;
+
+private:
+
+	const std::string _name;
+};
+
+/*! \brief A pipeline stage that runs a function on each input with its own
+ * threads, fed by a bounded input queue. Pushing blocks while the queue is
+ * full, so a slow stage stalls its upstream stages, and eventually the
+ * producer, instead of buffering without bound.
+ *
+ * The function returns false to drop an item, so stages can also filter.
+ * Outputs go to the sink, which is either the next stage or a terminal
+ * function such as a publisher. Outputs of a stage with more than one
+ * thread may be reordered. In must be default constructible.
+ */
+template <typename In, typename Out>
+class Stage
+: public PipelineStage
+{
+public:
+
+	typedef std::shared_ptr<Stage> Ptr;
+	typedef In InputType;
+	typedef Out OutputType;
+	typedef boost::function<bool( In&, Out& )> Func;
+	typedef boost::function<void( Out& )> Sink;
+
+	Stage( const std::string& name, const Func& func,
+	       unsigned int numThreads = 1, size_t queueSize = 16 )
+	: PipelineStage( name ), _func( func ), _numThreads( numThreads ),
+	  _queue( queueSize, OVERFLOW_BLOCK ), _stopped( false ), _numInFlight( 0 ),
+	  _numProcessed( 0 ), _numFiltered( 0 ), _latencyNs( 0 ), _processNs( 0 ),
+	  _statsStart( Clock::now() )
+	{
+		// An unbounded queue would defeat backpressure
+		if( queueSize == 0 )
+		{
+			throw std::invalid_argument( "Stage: Queue size must be positive." );
+		}
+		if( numThreads == 0 )
+		{
+			throw std::invalid_argument( "Stage: Number of threads must be positive." );
+		}
+	}
+
+	~Stage()
+	{
+		Stop();
+	}
+
+	/*! \brief Sends outputs to a function. Outputs are dropped if unset. */
+	void SetSink( const Sink& sink )
+	{
+		_sink = sink;
+	}
+
+	/*! \brief Sends outputs to the input of another stage. */
+	template <typename Next>
+	void ConnectTo( const std::shared_ptr< Stage<Out, Next> >& next )
+	{
+		_sink = [next]( Out& out ) { next->Push( std::move( out ) ); };
+	}
+
+	/*! \brief Queues an input, blocking while the stage is full. Returns
+	 * false if the stage was stopped. */
+	bool Push( const In& in )
+	{
+		return Enqueue( Item( in ), nullptr );
+	}
+
+	bool Push( In&& in )
+	{
+		return Enqueue( Item( std::move( in ) ), nullptr );
+	}
+
+	/*! \brief Queues an input, waiting at most timeout seconds for room.
+	 * Returns false on timeout or if the stage was stopped. */
+	bool PushFor( In in, double timeout )
+	{
+		return Enqueue( Item( std::move( in ) ), &timeout );
+	}
+
+	virtual void SetNumThreads( unsigned int n )
+	{
+		if( n == 0 )
+		{
+			throw std::invalid_argument( "Stage: Number of threads must be positive." );
+		}
+		_numThreads = n;
+	}
+
+	virtual void Start()
+	{
+		_pool.SetNumWorkers( _numThreads );
+		_pool.StartWorkers();
+		for( unsigned int i = 0; i < _numThreads; ++i )
+		{
+			_pool.EnqueueJob( boost::bind( &Stage::Run, this ) );
+		}
+	}
+
+	virtual void Stop()
+	{
+		_stopped.store( true );
+		_queue.Kill();
+		_pool.StopWorkers();
+		boost::unique_lock<boost::mutex> lock( _idleMutex );
+		_idle.notify_all();
+	}
+
+	virtual void WaitIdle()
+	{
+		boost::unique_lock<boost::mutex> lock( _idleMutex );
+		while( _numInFlight.load() > 0 && !_stopped.load() )
+		{
+			_idle.wait( lock );
+		}
+	}
+
+	virtual StageStatistics GetStatistics() const
+	{
+		StageStatistics stats;
+		stats.name = GetName();
+		stats.numThreads = _numThreads;
+		stats.numProcessed = _numProcessed.load();
+		stats.numFiltered = _numFiltered.load();
+		stats.queue = _queue.GetStatistics();
+
+		boost::unique_lock<boost::mutex> lock( _statsMutex );
+		double elapsed = ToSeconds( Clock::now() - _statsStart );
+		unsigned long numRun = stats.numProcessed + stats.numFiltered;
+		double processTime = 1E-9 * _processNs.load();
+		if( elapsed > 0 )
+		{
+			stats.throughput = stats.numProcessed / elapsed;
+			stats.utilization = processTime / ( elapsed * _numThreads );
+		}
+		if( stats.numProcessed > 0 )
+		{
+			stats.meanLatency = 1E-9 * _latencyNs.load() / stats.numProcessed;
+		}
+		if( numRun > 0 )
+		{
+			stats.meanProcessTime = processTime / numRun;
+		}
+		return stats;
+	}
+
+	virtual void ResetStatistics()
+	{
+		boost::unique_lock<boost::mutex> lock( _statsMutex );
+		_numProcessed.store( 0 );
+		_numFiltered.store( 0 );
+		_latencyNs.store( 0 );
+		_processNs.store( 0 );
+		_queue.ResetStatistics();
+		_statsStart = Clock::now();
+	}
+
+private:
+
+	typedef boost::chrono::steady_clock Clock;
+
+	struct Item
+	{
+		In data;
+		Clock::time_point enqueued;
+
+		Item() {}
+
+		Item( const In& d )
+		: data( d ), enqueued( Clock::now() ) {}
+
+		Item( In&& d )
+		: data( std::move( d ) ), enqueued( Clock::now() ) {}
+	};
+
+	Func _func;
+	Sink _sink;
+	unsigned int _numThreads;
+	WorkerPool _pool;
+	ThreadsafeQueue<Item> _queue;
+	std::atomic<bool> _stopped;
+
+	// Queued or being processed, for WaitIdle
+	std::atomic<unsigned int> _numInFlight;
+	boost::mutex _idleMutex;
+	boost::condition_variable _idle;
+
+	std::atomic<unsigned long> _numProcessed;
+	std::atomic<unsigned long> _numFiltered;
+	std::atomic<unsigned long> _latencyNs;
+	std::atomic<unsigned long> _processNs;
+	mutable boost::mutex _statsMutex;
+	Clock::time_point _statsStart;
+
+	static double ToSeconds( const Clock::duration& d )
+	{
+		return boost::chrono::duration<double>( d ).count();
+	}
+
+	static unsigned long ToNanoseconds( const Clock::duration& d )
+	{
+		return boost::chrono::duration_cast<boost::chrono::nanoseconds>( d ).count();
+	}
+
+	bool Enqueue( Item&& item, const double* timeout )
+	{
+		++_numInFlight;
+		bool pushed = timeout ? _queue.WaitPushFor( std::move( item ), *timeout )
+		                      : _queue.PushBack( std::move( item ) );
+		if( !pushed ) { Finished(); }
+		return pushed;
+	}
+
+	void Finished()
+	{
+		if( --_numInFlight == 0 )
+		{
+			boost::unique_lock<boost::mutex> lock( _idleMutex );
+			_idle.notify_all();
+		}
+	}
+
+	// Runs on a pool worker until the stage is stopped
+	void Run()
+	{
+		Item item;
+		Out out;
+		while( _queue.WaitPopFront( item ) )
+		{
+			Clock::time_point start = Clock::now();
+			bool keep = _func( item.data, out );
+			Clock::time_point finish = Clock::now();
+			_processNs.fetch_add( ToNanoseconds( finish - start ) );
+
+			if( keep )
+			{
+				_latencyNs.fetch_add( ToNanoseconds( finish - item.enqueued ) );
+				++_numProcessed;
+				// Blocks here if the next stage is full
+				if( _sink ) { _sink( out ); }
+			}
+			else
+			{
+				++_numFiltered;
+			}
+			Finished();
+		}
+	}
+};
+
+/*! \brief Owns a set of connected stages, so that a pipeline can be
+ * declared once and then started, stopped and monitored as a unit. */
+class Pipeline
+{
+public:
+
+	Pipeline() {}
+
+	~Pipeline()
+	{
+		Stop();
+	}
+
+	/*! \brief Creates a stage and adds it to the pipeline. Stages should be
+	 * added from upstream to downstream. */
+	template <typename In, typename Out>
+	typename Stage<In, Out>::Ptr AddStage( const std::string& name,
+	                                       const typename Stage<In, Out>::Func& func,
+	                                       unsigned int numThreads = 1,
+	                                       size_t queueSize = 16 )
+	{
+		if( GetStage( name ) )
+		{
+			throw std::invalid_argument( "Pipeline: Stage " + name + " already exists." );
+		}
+		typename Stage<In, Out>::Ptr stage =
+		    std::make_shared< Stage<In, Out> >( name, func, numThreads, queueSize );
+		_stages.push_back( stage );
+		return stage;
+	}
+
+	/*! \brief Returns the named stage, or nullptr if it does not exist. */
+	PipelineStage::Ptr GetStage( const std::string& name ) const
+	{
+		for( unsigned int i = 0; i < _stages.size(); ++i )
+		{
+			if( _stages[i]->GetName() == name ) { return _stages[i]; }
+		}
+		return PipelineStage::Ptr();
+	}
+
+	/*! \brief Starts the stages from downstream to upstream. */
+	void Start()
+	{
+		for( unsigned int i = _stages.size(); i > 0; --i )
+		{
+			_stages[i-1]->Start();
+		}
+	}
+
+	/*! \brief Stops the stages from upstream to downstream. */
+	void Stop()
+	{
+		for( unsigned int i = 0; i < _stages.size(); ++i )
+		{
+			_stages[i]->Stop();
+		}
+	}
+
+	/*! \brief Blocks until every item pushed so far has left the pipeline. */
+	void WaitIdle()
+	{
+		for( unsigned int i = 0; i < _stages.size(); ++i )
+		{
+			_stages[i]->WaitIdle();
+		}
+	}
+
+	std::vector<StageStatistics> GetStatistics() const
+	{
+		std::vector<StageStatistics> stats;
+		for( unsigned int i = 0; i < _stages.size(); ++i )
+		{
+			stats.push_back( _stages[i]->GetStatistics() );
+		}
+		return stats;
+	}
+
+	void ResetStatistics()
+	{
+		for( unsigned int i = 0; i < _stages.size(); ++i )
+		{
+			_stages[i]->ResetStatistics();
+		}
+	}
+
+private:
+
+	std::vector<PipelineStage::Ptr> _stages;
+
+	Pipeline( const Pipeline& other );
+	Pipeline& operator=( const Pipeline& other );
+};
+
+}
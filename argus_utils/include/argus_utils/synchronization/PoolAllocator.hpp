@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "argus_utils/synchronization/SynchronizationTypes.h"
+
+namespace argus
+{
+
+/*! \brief A thread-safe free list of fixed-size blocks. Blocks are carved
+ * from chunks that are only released when the pool is destroyed, so once a
+ * pool has grown to its working size, allocating never reaches malloc.
+ * Blocks are aligned to Alignment bytes, and block sizes are rounded up to a
+ * multiple of it. */
+class BlockPool
+{
+public:
+
+	// A cache line, which also covers over-aligned vectorized Eigen types
+	static const size_t Alignment = 64;
+
+	BlockPool( size_t blockSize, size_t blocksPerChunk = 64 )
+	: _blockSize( ( std::max( blockSize, sizeof( FreeBlock ) ) + Alignment - 1 ) &
+	              ~( Alignment - 1 ) ),
+	  _blocksPerChunk( blocksPerChunk ), _free( nullptr ) {}
+
+	~BlockPool()
+	{
+		for( size_t i = 0; i < _chunks.size(); ++i )
+		{
+			::operator delete( _chunks[i] );
+		}
+	}
+
+	size_t BlockSize() const
+	{
+		return _blockSize;
+	}
+
+	void* Allocate()
+	{
+		Lock lock( _mutex );
+		if( !_free ) { Grow(); }
+		FreeBlock* block = _free;
+		_free = block->next;
+		return block;
+	}
+
+	void Deallocate( void* ptr )
+	{
+		FreeBlock* block = static_cast<FreeBlock*>( ptr );
+		Lock lock( _mutex );
+		block->next = _free;
+		_free = block;
+	}
+
+private:
+
+	typedef boost::unique_lock<SpinMutex> Lock;
+
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	const size_t _blockSize;
+	const size_t _blocksPerChunk;
+	SpinMutex _mutex;
+	FreeBlock* _free;
+	std::vector<void*> _chunks;
+
+	void Grow()
+	{
+		// operator new only guarantees fundamental alignment, so align the
+		// first block within the chunk
+		void* raw = ::operator new( _blockSize * _blocksPerChunk + Alignment - 1 );
+		_chunks.push_back( raw );
+		uintptr_t address = reinterpret_cast<uintptr_t>( raw );
+		char* chunk = reinterpret_cast<char*>( ( address + Alignment - 1 ) & ~( Alignment - 1 ) );
+		for( size_t i = _blocksPerChunk; i > 0; --i )
+		{
+			FreeBlock* block = reinterpret_cast<FreeBlock*>( chunk + ( i - 1 ) * _blockSize );
+			block->next = _free;
+			_free = block;
+		}
+	}
+
+	BlockPool( const BlockPool& other );
+	BlockPool& operator=( const BlockPool& other );
+};
+
+/*! \brief Process-wide pools for power-of-two size classes from 64 to 1024
+ * bytes. Larger requests go to operator new. All memory is aligned to
+ * Alignment bytes, so types aligned up to that may be placed in it. */
+class PooledMemory
+{
+public:
+
+	static const size_t MinBlockSize = 64;
+	static const size_t MaxBlockSize = 1024;
+	static const size_t Alignment = BlockPool::Alignment;
+
+	static void* Allocate( size_t bytes )
+	{
+		BlockPool* pool = GetPool( bytes );
+		return pool ? pool->Allocate() : AllocateLarge( bytes );
+	}
+
+	static void Deallocate( void* ptr, size_t bytes )
+	{
+		BlockPool* pool = GetPool( bytes );
+		if( pool ) { pool->Deallocate( ptr ); }
+		else { ::operator delete( static_cast<void**>( ptr )[-1] ); }
+	}
+
+private:
+
+	/*! \brief Aligns within a larger allocation, keeping the allocation's
+	 * address just before the returned memory. */
+	static void* AllocateLarge( size_t bytes )
+	{
+		void* raw = ::operator new( bytes + Alignment );
+		uintptr_t address = reinterpret_cast<uintptr_t>( raw ) + sizeof( void* );
+		void** aligned = reinterpret_cast<void**>( ( address + Alignment - 1 ) & ~( Alignment - 1 ) );
+		aligned[-1] = raw;
+		return aligned;
+	}
+
+	static const unsigned int NumClasses = 5;
+
+	static BlockPool* GetPool( size_t bytes )
+	{
+		// Never destroyed, so blocks may be released during static destruction
+		static BlockPool* pools[NumClasses] = {
+			new BlockPool( 64 ), new BlockPool( 128 ), new BlockPool( 256 ),
+			new BlockPool( 512 ), new BlockPool( 1024 )
+		};
+
+		size_t size = MinBlockSize;
+		for( unsigned int i = 0; i < NumClasses; ++i, size *= 2 )
+		{
+			if( bytes <= size ) { return pools[i]; }
+		}
+		return nullptr;
+	}
+};
+
+/*! \brief A standard allocator that draws from PooledMemory, for node-based
+ * containers that allocate and free at a high rate. */
+template <typename T>
+class PoolAllocator
+{
+public:
+
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template <typename U>
+	struct rebind
+	{
+		typedef PoolAllocator<U> other;
+	};
+
+	PoolAllocator() {}
+
+	template <typename U>
+	PoolAllocator( const PoolAllocator<U>& other ) {}
+
+	pointer allocate( size_type n, const void* hint = 0 )
+	{
+		static_assert( std::alignment_of<T>::value <= PooledMemory::Alignment,
+		               "PoolAllocator: Type is aligned beyond PooledMemory::Alignment." );
+		return static_cast<pointer>( PooledMemory::Allocate( n * sizeof( T ) ) );
+	}
+
+	void deallocate( pointer ptr, size_type n )
+	{
+		PooledMemory::Deallocate( ptr, n * sizeof( T ) );
+	}
+
+	template <typename U, typename... Args>
+	void construct( U* ptr, Args&&... args )
+	{
+		new ( ptr ) U( std::forward<Args>( args )... );
+	}
+
+	template <typename U>
+	void destroy( U* ptr )
+	{
+		ptr->~U();
+	}
+
+	pointer address( reference x ) const { return &x; }
+	const_pointer address( const_reference x ) const { return &x; }
+
+	size_type max_size() const
+	{
+		return std::numeric_limits<size_type>::max() / sizeof( T );
+	}
+};
+
+template <typename T, typename U>
+bool operator==( const PoolAllocator<T>& a, const PoolAllocator<U>& b )
+{
+	return true;
+}
+
+template <typename T, typename U>
+bool operator!=( const PoolAllocator<T>& a, const PoolAllocator<U>& b )
+{
+	return false;
+}
+
+}
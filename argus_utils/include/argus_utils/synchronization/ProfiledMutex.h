@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/thread/shared_mutex.hpp>
+
+#include "argus_utils/ArgusConfig.h"
+
+namespace argus
+{
+
+/*! \brief Contention metrics for all mutexes sharing a lock site name.
+ * Times are in seconds. For shared acquisitions, hold time is the time
+ * during which at least one reader held the mutex. */
+struct LockSiteStatistics
+{
+	std::string name;
+	unsigned long numAcquisitions;
+	unsigned long numContended; // Acquisitions that had to wait
+	double waitTime;
+	double holdTime;
+	double maxWaitTime;
+	double maxHoldTime;
+
+	LockSiteStatistics();
+};
+
+/*! \brief Running counters for a named lock site. Created and owned by the
+ * site registry, and shared by every mutex with the same name. */
+class LockSite
+{
+public:
+
+	typedef std::shared_ptr<LockSite> Ptr;
+
+	/*! \brief Returns the site with the given name, creating it if needed. */
+	static Ptr Get( const std::string& name );
+
+	LockSite( const std::string& name );
+
+	void RecordAcquire( unsigned long waitNs, bool contended );
+	void RecordHold( unsigned long holdNs );
+
+	LockSiteStatistics GetStatistics() const;
+	void Reset();
+
+private:
+
+	const std::string _name;
+	std::atomic<unsigned long> _numAcquisitions;
+	std::atomic<unsigned long> _numContended;
+	std::atomic<unsigned long> _waitNs;
+	std::atomic<unsigned long> _holdNs;
+	std::atomic<unsigned long> _maxWaitNs;
+	std::atomic<unsigned long> _maxHoldNs;
+};
+
+/*! \brief A reader-writer mutex that records wait time, hold time and
+ * acquisition counts to its lock site. A drop-in replacement for
+ * boost::shared_mutex, used for argus::Mutex when argus_utils is configured
+ * with ARGUS_PROFILE_LOCKS. Mutexes start in the "unnamed" site until named with NameLock. */
+class ProfiledSharedMutex
+{
+public:
+
+	ProfiledSharedMutex();
+	ProfiledSharedMutex( const std::string& name );
+
+	/*! \brief Moves this mutex to a different lock site. Must not be called
+	 * while the mutex is held. */
+	void SetName( const std::string& name );
+
+	void lock();
+	bool try_lock();
+	void unlock();
+
+	void lock_shared();
+	bool try_lock_shared();
+	void unlock_shared();
+
+private:
+
+	boost::shared_mutex _mutex;
+	LockSite::Ptr _site;
+	std::atomic<unsigned int> _numReaders;
+	std::atomic<unsigned long> _holdStart; // ns since clock epoch
+
+	void Acquired( unsigned long start, bool contended );
+	void AcquiredShared( unsigned long start, bool contended );
+
+	ProfiledSharedMutex( const ProfiledSharedMutex& other );
+	ProfiledSharedMutex& operator=( const ProfiledSharedMutex& other );
+};
+
+/*! \brief Assigns a mutex to a named lock site. Does nothing for mutexes
+ * that are not profiled, so it can be called unconditionally. */
+template <typename M>
+void NameLock( M& mutex, const std::string& name ) {}
+
+inline void NameLock( ProfiledSharedMutex& mutex, const std::string& name )
+{
+	mutex.SetName( name );
+}
+
+/*! \brief Returns the metrics of every lock site, sorted by total wait time. */
+std::vector<LockSiteStatistics> GetLockStatistics();
+
+/*! \brief Zeroes the metrics of every lock site. */
+void ResetLockStatistics();
+
+/*! \brief Writes a table of all lock site metrics. */
+void DumpLockStatistics( std::ostream& os );
+
+/*! \brief Sets whether the lock statistics are written to stderr when the
+ * process exits. Defaults to true if built with ARGUS_PROFILE_LOCKS. */
+void SetDumpLockStatisticsOnExit( bool enable );
+
+}
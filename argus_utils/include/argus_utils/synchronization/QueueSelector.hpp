@@ -0,0 +1,262 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "argus_utils/synchronization/ThreadsafeQueue.hpp"
+
+namespace argus
+{
+
+/*! \brief Blocks a single consumer thread until any of a set of queues has
+ * items, like select() for ThreadsafeQueues, so that one thread can serve
+ * many queues without polling.
+ *
+ * Queues push a wakeup to the selector, so an idle selector costs nothing.
+ * Readiness is level-triggered: a queue is reported for as long as it is
+ * non-empty, and ready queues are reported round-robin so that a busy queue
+ * cannot starve the others. Items are left in the queue for the caller to
+ * pop. Only one thread may wait at a time.
+ *
+ * Queues must be removed with Remove or Clear, or the selector destroyed,
+ * before the queues are destroyed. A wait in progress on another thread may
+ * still check a queue once after it is removed, so a queue removed from
+ * another thread must also outlive that wait. Each queue should be added
+ * once, since removing it detaches the selector from the queue entirely.
+ */
+class QueueSelector
+: public QueueListener
+{
+public:
+
+	QueueSelector()
+	: _live( true ), _numQueues( 0 ), _next( 0 ), _generation( 0 ) {}
+
+	~QueueSelector()
+	{
+		Clear();
+	}
+
+	/*! \brief Adds a queue and returns its index, which is what Wait reports
+	 * when it is ready. */
+	template <class Queue>
+	unsigned int Add( Queue& queue )
+	{
+		unsigned int index;
+		{
+			boost::unique_lock<boost::mutex> lock( _mutex );
+			index = _sources.size();
+			std::shared_ptr<Source> source = std::make_shared<Source>();
+			source->isEmpty = boost::bind( &Queue::IsEmpty, &queue );
+			source->detach = boost::bind( &Queue::RemoveListener, &queue, this );
+			_sources.push_back( source );
+			_flagged.push_back( true ); // Checked in case it already has items
+			++_numQueues;
+			_hasFlags.notify_all();
+		}
+		queue.AddListener( this, index );
+		return index;
+	}
+
+	/*! \brief Detaches from the queue at index. The indices of the other
+	 * queues are unchanged. Returns false if there is no such queue. */
+	bool Remove( unsigned int index )
+	{
+		std::shared_ptr<Source> source;
+		{
+			boost::unique_lock<boost::mutex> lock( _mutex );
+			if( index >= _sources.size() || !_sources[index] ) { return false; }
+			source.swap( _sources[index] );
+			_flagged[index] = false;
+			--_numQueues;
+			++_generation;
+		}
+		source->detach();
+		return true;
+	}
+
+	/*! \brief Detaches from all queues. Indices restart from zero. */
+	void Clear()
+	{
+		std::vector< std::shared_ptr<Source> > sources;
+		{
+			boost::unique_lock<boost::mutex> lock( _mutex );
+			sources.swap( _sources );
+			_flagged.clear();
+			_numQueues = 0;
+			_next = 0;
+			++_generation;
+		}
+		for( unsigned int i = 0; i < sources.size(); ++i )
+		{
+			if( sources[i] ) { sources[i]->detach(); }
+		}
+	}
+
+	/*! \brief Returns the number of attached queues. */
+	unsigned int Size() const
+	{
+		boost::unique_lock<boost::mutex> lock( _mutex );
+		return _numQueues;
+	}
+
+	/*! \brief Unblocks waiting threads. Waits return false afterwards. */
+	void Kill()
+	{
+		boost::unique_lock<boost::mutex> lock( _mutex );
+		_live = false;
+		_hasFlags.notify_all();
+	}
+
+	/*! \brief Waits until a queue has items and returns its index. Returns
+	 * false if the selector was killed. */
+	bool Wait( unsigned int& index )
+	{
+		if( !Collect( nullptr, 1, _ready ) ) { return false; }
+		index = _ready.front();
+		return true;
+	}
+
+	/*! \brief Waits at most timeout seconds for a queue to have items.
+	 * Returns false on timeout or if the selector was killed. */
+	bool WaitFor( unsigned int& index, double timeout )
+	{
+		Clock::time_point deadline = ToDeadline( timeout );
+		if( !Collect( &deadline, 1, _ready ) ) { return false; }
+		index = _ready.front();
+		return true;
+	}
+
+	/*! \brief Waits until any queue has items, then returns the indices of all
+	 * non-empty queues in ready. Returns false if the selector was killed. */
+	bool WaitAll( std::vector<unsigned int>& ready )
+	{
+		return Collect( nullptr, 0, ready );
+	}
+
+	virtual void OnPush( unsigned int tag )
+	{
+		boost::unique_lock<boost::mutex> lock( _mutex );
+		if( tag < _flagged.size() && !_flagged[tag] )
+		{
+			_flagged[tag] = true;
+			_hasFlags.notify_one();
+		}
+	}
+
+private:
+
+	typedef boost::chrono::steady_clock Clock;
+
+	struct Source
+	{
+		boost::function<bool()> isEmpty;
+		boost::function<void()> detach;
+	};
+
+	mutable boost::mutex _mutex;
+	boost::condition_variable _hasFlags;
+	bool _live;
+	std::vector< std::shared_ptr<Source> > _sources; // Null once removed
+	std::vector<bool> _flagged; // May have items since last checked
+	unsigned int _numQueues;
+	unsigned int _next; // Round-robin start
+	unsigned long _generation; // Bumped when indices are removed
+
+	// Reused by Collect so that waiting does not allocate. Sources are held
+	// so that they outlive a concurrent Remove or Clear
+	std::vector<unsigned int> _ready;
+	std::vector<unsigned int> _candidates;
+	std::vector< std::shared_ptr<Source> > _checking;
+	std::vector<bool> _nonEmpty;
+
+	static Clock::time_point ToDeadline( double timeout )
+	{
+		return Clock::now() + boost::chrono::duration_cast<Clock::duration>(
+		           boost::chrono::duration<double>( timeout ) );
+	}
+
+	/*! \brief Waits for flagged queues and checks them, up to maxNum ready
+	 * queues or all if zero. Queues are checked without the selector locked,
+	 * since pushes call OnPush with the queue locked. */
+	bool Collect( const Clock::time_point* deadline, unsigned int maxNum,
+	              std::vector<unsigned int>& ready )
+	{
+		ready.clear();
+		boost::unique_lock<boost::mutex> lock( _mutex );
+		while( _live )
+		{
+			// Clear flags before checking, so pushes after the check re-flag.
+			// Removed queues may still be flagged by a push in flight
+			_candidates.clear();
+			_checking.clear();
+			unsigned int num = _flagged.size();
+			for( unsigned int i = 0; i < num; ++i )
+			{
+				unsigned int ind = ( _next + i ) % num;
+				if( !_flagged[ind] ) { continue; }
+				_flagged[ind] = false;
+				if( !_sources[ind] ) { continue; }
+				_candidates.push_back( ind );
+				_checking.push_back( _sources[ind] );
+			}
+
+			if( !_candidates.empty() )
+			{
+				unsigned long generation = _generation;
+				lock.unlock();
+				_nonEmpty.assign( _candidates.size(), false );
+				unsigned int numChecked = 0;
+				for( ; numChecked < _candidates.size(); ++numChecked )
+				{
+					if( maxNum > 0 && ready.size() >= maxNum ) { break; }
+					if( !_checking[numChecked]->isEmpty() )
+					{
+						_nonEmpty[numChecked] = true;
+						ready.push_back( _candidates[numChecked] );
+					}
+				}
+				lock.lock();
+				_checking.clear();
+
+				// If queues were removed while unlocked, the indices may now
+				// refer to other queues, so recheck every candidate still there
+				bool stale = generation != _generation;
+				if( stale ) { ready.clear(); }
+				for( unsigned int i = 0; i < _candidates.size(); ++i )
+				{
+					unsigned int ind = _candidates[i];
+					if( ind < _flagged.size() && _sources[ind] &&
+					    ( stale || _nonEmpty[i] || i >= numChecked ) )
+					{
+						_flagged[ind] = true;
+					}
+				}
+				if( !ready.empty() )
+				{
+					_next = ( ready.back() + 1 ) % std::max<size_t>( _flagged.size(), 1 );
+					return true;
+				}
+				continue;
+			}
+
+			if( !deadline ) { _hasFlags.wait( lock ); }
+			else if( _hasFlags.wait_until( lock, *deadline ) == boost::cv_status::timeout &&
+			         std::find( _flagged.begin(), _flagged.end(), true ) == _flagged.end() )
+			{
+				return false;
+			}
+		}
+		return false;
+	}
+
+	QueueSelector( const QueueSelector& other );
+	QueueSelector& operator=( const QueueSelector& other );
+};
+
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+#include "argus_utils/synchronization/SynchronizationTypes.h"
+
+namespace argus
+{
+
+/*! \brief A fixed-capacity lock-free multi-producer/multi-consumer FIFO queue.
+ * Pushes and pops claim slots in a ring with a single compare-and-swap, so no
+ * lock is taken unless a consumer has to sleep on an empty queue. When the
+ * queue is full, pushing drops the oldest item, matching ThreadsafeQueue with
+ * a max size set.
+ *
+ * Based on the bounded MPMC queue of D. Vyukov. Each slot carries a sequence
+ * number that tells producers and consumers whose turn it is.
+ */
+template <class T>
+class RingQueue
+{
+public:
+
+	typedef T DataType;
+
+	/*! \brief A capacity of 1 is rounded up to 2, since with a single slot
+	 * the sequence numbers cannot tell a full queue from an empty one. */
+	RingQueue( size_t capacity )
+	: _capacity( capacity == 1 ? 2 : capacity ), _cells( _capacity ), _head( 0 ), _tail( 0 ),
+	  _numWaiting( 0 ), _live( true )
+	{
+		if( capacity == 0 )
+		{
+			throw std::invalid_argument( "RingQueue: Capacity must be positive." );
+		}
+		NameLock( _waitMutex, "RingQueue::wait" );
+		for( size_t i = 0; i < _capacity; ++i )
+		{
+			_cells[i].sequence.store( i, std::memory_order_relaxed );
+		}
+	}
+
+	~RingQueue()
+	{
+		Kill();
+		while( DiscardFront() ) {}
+	}
+
+	// Allows blocked threads to quit
+	void Kill()
+	{
+		_live.store( false );
+		WriteLock lock( _waitMutex );
+		_hasContents.notify_all();
+	}
+
+	size_t Capacity() const
+	{
+		return _capacity;
+	}
+
+	template <class... Args>
+	void EmplaceBack( Args&&... args )
+	{
+		// Drop the oldest item until there is room
+		while( !TryEmplace( std::forward<Args>( args )... ) )
+		{
+			DiscardFront();
+		}
+		NotifyWaiters();
+	}
+
+	void PushBack( const T& item )
+	{
+		EmplaceBack( item );
+	}
+
+	void PushBack( T&& item )
+	{
+		EmplaceBack( std::move( item ) );
+	}
+
+	/*! \brief Pushes the item only if there is room. Returns success. */
+	bool TryPushBack( const T& item )
+	{
+		if( !TryEmplace( item ) ) { return false; }
+		NotifyWaiters();
+		return true;
+	}
+
+	bool TryPopFront( T& item )
+	{
+		Cell* cell;
+		size_t pos;
+		if( !ClaimFront( cell, pos ) ) { return false; }
+
+		T* ptr = cell->Get();
+		item = std::move( *ptr );
+		ptr->~T();
+		cell->sequence.store( pos + _capacity, std::memory_order_release );
+		return true;
+	}
+
+	/*! \brief Pops the oldest item, sleeping only while the queue is empty.
+	 * Returns false if the queue was killed while waiting. */
+	bool WaitPopFront( T& item )
+	{
+		while( true )
+		{
+			if( TryPopFront( item ) ) { return true; }
+			if( !_live.load() ) { return false; }
+
+			WriteLock lock( _waitMutex );
+			_numWaiting.fetch_add( 1 );
+			// Pairs with the fence in NotifyWaiters so that either we see the
+			// new item here or the producer sees us waiting
+			std::atomic_thread_fence( std::memory_order_seq_cst );
+			if( !IsEmpty() || !_live.load() )
+			{
+				_numWaiting.fetch_sub( 1 );
+				continue;
+			}
+			_hasContents.wait( lock );
+			_numWaiting.fetch_sub( 1 );
+		}
+	}
+
+	/*! \brief Returns the approximate number of items. Exact only when no
+	 * other threads are pushing or popping. */
+	size_t Size() const
+	{
+		size_t tail = _tail.load( std::memory_order_acquire );
+		size_t head = _head.load( std::memory_order_acquire );
+		return ( tail > head ) ? tail - head : 0;
+	}
+
+	bool IsEmpty() const
+	{
+		return Size() == 0;
+	}
+
+	void Clear()
+	{
+		while( DiscardFront() ) {}
+	}
+
+private:
+
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		typename std::aligned_storage<sizeof( T ), std::alignment_of<T>::value>::type storage;
+
+		Cell() : sequence( 0 ) {}
+		Cell( const Cell& other ) : sequence( other.sequence.load() ) {}
+
+		T* Get() { return reinterpret_cast<T*>( &storage ); }
+	};
+
+	// Keeps the producer and consumer indices on separate cache lines
+	static const size_t CacheLineSize = 64;
+
+	const size_t _capacity;
+	std::vector<Cell> _cells;
+
+	char _pad0[CacheLineSize];
+	std::atomic<size_t> _head;
+	char _pad1[CacheLineSize - sizeof( std::atomic<size_t> )];
+	std::atomic<size_t> _tail;
+	char _pad2[CacheLineSize - sizeof( std::atomic<size_t> )];
+
+	std::atomic<unsigned int> _numWaiting;
+	std::atomic<bool> _live;
+	Mutex _waitMutex;
+	ConditionVariable _hasContents;
+
+	template <class... Args>
+	bool TryEmplace( Args&&... args )
+	{
+		size_t pos = _tail.load( std::memory_order_relaxed );
+		Cell* cell;
+		while( true )
+		{
+			cell = &_cells[pos % _capacity];
+			size_t seq = cell->sequence.load( std::memory_order_acquire );
+			intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+			if( diff == 0 )
+			{
+				if( _tail.compare_exchange_weak( pos, pos + 1,
+				                                 std::memory_order_relaxed ) )
+				{
+					break;
+				}
+			}
+			else if( diff < 0 ) { return false; }
+			else { pos = _tail.load( std::memory_order_relaxed ); }
+		}
+
+		new ( cell->Get() ) T( std::forward<Args>( args )... );
+		cell->sequence.store( pos + 1, std::memory_order_release );
+		return true;
+	}
+
+	bool ClaimFront( Cell*& cell, size_t& pos )
+	{
+		pos = _head.load( std::memory_order_relaxed );
+		while( true )
+		{
+			cell = &_cells[pos % _capacity];
+			size_t seq = cell->sequence.load( std::memory_order_acquire );
+			intptr_t diff = (intptr_t) seq - (intptr_t) ( pos + 1 );
+			if( diff == 0 )
+			{
+				if( _head.compare_exchange_weak( pos, pos + 1,
+				                                 std::memory_order_relaxed ) )
+				{
+					return true;
+				}
+			}
+			else if( diff < 0 ) { return false; }
+			else { pos = _head.load( std::memory_order_relaxed ); }
+		}
+	}
+
+	bool DiscardFront()
+	{
+		Cell* cell;
+		size_t pos;
+		if( !ClaimFront( cell, pos ) ) { return false; }
+		cell->Get()->~T();
+		cell->sequence.store( pos + _capacity, std::memory_order_release );
+		return true;
+	}
+
+	void NotifyWaiters()
+	{
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		if( _numWaiting.load() == 0 ) { return; }
+		WriteLock lock( _waitMutex );
+		_hasContents.notify_one();
+	}
+
+	RingQueue( const RingQueue& other );
+	RingQueue& operator=( const RingQueue& other );
+};
+
+}
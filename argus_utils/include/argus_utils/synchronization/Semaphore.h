@@ -1,33 +1,54 @@
 #pragma once
 
+#include <atomic>
 #include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
+#include <boost/chrono.hpp>
 #include "argus_utils/synchronization/SynchronizationTypes.h"
 
 namespace argus 
 {
 
-/*! \brief A standard semaphore class. */
+/*! \brief A standard semaphore class. The counter is atomic, so increments
+ * and successful decrements do not lock. The mutex is only taken when a
+ * decrement has to wait, or to wake a waiting thread. */
 class Semaphore 
 {
 public:
 
 	Semaphore( int startCounter = 0 );
 	
+	/*! \brief Adds counters and wakes up to that many waiting threads. */
 	void Increment( int i = 1 );
 	
+	/*! \brief Removes counters, waiting until enough are available. */
 	void Decrement( int i = 1 );
 
-	// TODO IncrementWait and DecrementWait
+	/*! \brief Removes counters only if enough are available. Returns success. */
+	bool TryDecrement( int i = 1 );
+
+	/*! \brief Removes counters, waiting at most timeout seconds for enough
+	 * to become available. Returns success. */
+	bool DecrementFor( double timeout, int i = 1 );
 	
 	/*! \brief Returns how many counters are available. */
 	int Query() const;
 	
 protected:
 
-	mutable Mutex mutex;
-	int counter;
-	ConditionVariable hasCounters;
+	typedef boost::chrono::steady_clock Clock;
+	typedef boost::unique_lock<boost::mutex> Lock;
+
+	std::atomic<int> counter;
+	std::atomic<int> numWaiting;
+	std::atomic<int> numMultiWaiting; // Waiters needing more than one counter
+
+	// Only used to park waiting threads
+	boost::mutex mutex;
+	boost::condition_variable hasCounters;
+
+	bool WaitDecrement( int i, const Clock::time_point* deadline );
 	
 };
 
@@ -0,0 +1,483 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <type_traits>
+
+#include "argus_utils/synchronization/ThreadsafeQueue.hpp"
+
+namespace argus
+{
+
+/*! \brief Container tag that selects the single-producer/single-consumer
+ * ThreadsafeQueue below, ie. ThreadsafeQueue<T, SpscRing>. Never defined. */
+template <typename T, typename Alloc>
+class SpscRing;
+
+/*! \brief A fixed-capacity single-producer/single-consumer ThreadsafeQueue.
+ * Pushing and popping take no locks, and locks are only taken to park a
+ * consumer on an empty queue or a blocked producer on a full one. Each cell
+ * carries a sequence number, so the producer can claim the oldest item to
+ * drop it. Neither side is wait-free: pops claim the head by compare and
+ * swap, and a producer dropping the oldest item on a full queue spins while
+ * the consumer finishes moving out an item it has already claimed.
+ *
+ * Only one thread may push and only one thread may pop at a time, and only
+ * the FIFO half of the interface is provided. The other operations of
+ * ThreadsafeQueue fail to compile, so that swapping containers fails loudly
+ * rather than changing behavior. Since the ring is fixed, the capacity has to
+ * be given, and there is no default constructor.
+ */
+template <class T>
+class ThreadsafeQueue<T, SpscRing>
+{
+public:
+
+	typedef T DataType;
+
+	ThreadsafeQueue( size_t capacity,
+	                 OverflowPolicy policy = OVERFLOW_DROP_OLDEST )
+	: _capacity( capacity ), _cells( capacity ), _policy( policy ),
+	  _head( 0 ), _tail( 0 ),
+	  _numWaiting( 0 ), _live( true ),
+	  _numPushed( 0 ), _numPopped( 0 ), _numDropped( 0 ), _numRejected( 0 ),
+	  _highWaterMark( 0 ), _pushBlockedTime( 0 ), _popBlockedTime( 0 )
+	{
+		if( capacity == 0 )
+		{
+			throw std::invalid_argument( "SpscQueue: Capacity must be positive." );
+		}
+		for( size_t i = 0; i < capacity; ++i )
+		{
+			_cells[i].sequence.store( i, std::memory_order_relaxed );
+		}
+		NameLock( _waitMutex, "SpscQueue::wait" );
+	}
+
+	ThreadsafeQueue() = delete;
+
+	~ThreadsafeQueue()
+	{
+		Kill();
+		Clear();
+	}
+
+	// Allows blocked threads to quit
+	void Kill()
+	{
+		_live.store( false );
+		WriteLock lock( _waitMutex );
+		_changed.notify_all();
+	}
+
+	size_t Capacity() const
+	{
+		return _capacity;
+	}
+
+	/*! \brief Takes effect at the producer's next push. */
+	void SetOverflowPolicy( OverflowPolicy policy )
+	{
+		_policy.store( policy, std::memory_order_relaxed );
+	}
+
+	/*! \brief Constructs an item at the back. Returns false if the item was
+	 * dropped, or the queue was killed while waiting for room. */
+	template <class... Args>
+	bool EmplaceBack( Args&&... args )
+	{
+		return Insert( nullptr, std::forward<Args>( args )... );
+	}
+
+	bool PushBack( const T& item )
+	{
+		return EmplaceBack( item );
+	}
+
+	bool PushBack( T&& item )
+	{
+		return EmplaceBack( std::move( item ) );
+	}
+
+	/*! \brief Pushes onto the back, waiting at most timeout seconds for room
+	 * if full. Returns false on timeout. */
+	template <class Item>
+	bool WaitPushFor( Item&& item, double timeout )
+	{
+		Clock::time_point deadline = ToDeadline( timeout );
+		return Insert( &deadline, std::forward<Item>( item ) );
+	}
+
+	template <class InputIt>
+	size_t PushRange( InputIt first, InputIt last )
+	{
+		size_t num = 0;
+		for( ; first != last && _live.load(); ++first )
+		{
+			if( Insert( nullptr, *first ) ) { ++num; }
+		}
+		return num;
+	}
+
+	bool TryPopFront( T& item )
+	{
+		if( !Claim( &item ) ) { return false; }
+		Increment( _numPopped );
+		NotifyWaiters();
+		return true;
+	}
+
+	/*! \brief Waits for an item and moves it out of the front. Returns false
+	 * if the queue was killed while waiting. */
+	bool WaitPopFront( T& item )
+	{
+		return WaitPop( item, nullptr );
+	}
+
+	/*! \brief Waits at most timeout seconds for an item. Returns false on
+	 * timeout or if the queue was killed. */
+	bool WaitPopFor( T& item, double timeout )
+	{
+		Clock::time_point deadline = ToDeadline( timeout );
+		return WaitPop( item, &deadline );
+	}
+
+	template <class OutContainer>
+	size_t PopUpTo( size_t n, OutContainer& out )
+	{
+		size_t num = 0;
+		T item;
+		while( num < n && TryPopFront( item ) )
+		{
+			out.insert( out.end(), std::move( item ) );
+			++num;
+		}
+		return num;
+	}
+
+	template <class OutContainer>
+	size_t PopAll( OutContainer& out )
+	{
+		return PopUpTo( _capacity, out );
+	}
+
+	template <class OutContainer>
+	size_t WaitPopAll( OutContainer& out )
+	{
+		T item;
+		if( !WaitPopFront( item ) ) { return 0; }
+		out.insert( out.end(), std::move( item ) );
+		return PopAll( out ) + 1;
+	}
+
+	/*! \brief Returns the number of items. Exact only when called from the
+	 * producer or consumer thread. */
+	size_t Size() const
+	{
+		size_t tail = _tail.load( std::memory_order_acquire );
+		size_t head = _head.load( std::memory_order_acquire );
+		return ( tail > head ) ? tail - head : 0;
+	}
+
+	bool IsEmpty() const
+	{
+		return Size() == 0;
+	}
+
+	/*! \brief Discards all items. Must be called from the consumer thread. */
+	void Clear()
+	{
+		while( Claim( nullptr ) ) {}
+		NotifyWaiters();
+	}
+
+	/*! \brief Waits for the consumer to empty the queue. */
+	void WaitEmpty()
+	{
+		WaitFor( &ThreadsafeQueue::IsEmpty, nullptr );
+	}
+
+	void WaitHasContents()
+	{
+		WaitFor( &ThreadsafeQueue::HasContents, nullptr );
+	}
+
+	QueueStatistics GetStatistics() const
+	{
+		QueueStatistics stats;
+		stats.numPushed = _numPushed.load( std::memory_order_relaxed );
+		stats.numPopped = _numPopped.load( std::memory_order_relaxed );
+		stats.numDropped = _numDropped.load( std::memory_order_relaxed );
+		stats.numRejected = _numRejected.load( std::memory_order_relaxed );
+		stats.highWaterMark = _highWaterMark.load( std::memory_order_relaxed );
+		stats.pushBlockedTime = _pushBlockedTime.load( std::memory_order_relaxed );
+		stats.popBlockedTime = _popBlockedTime.load( std::memory_order_relaxed );
+		return stats;
+	}
+
+	/*! \brief Counts made while resetting from a third thread may be lost. */
+	void ResetStatistics()
+	{
+		_numPushed.store( 0, std::memory_order_relaxed );
+		_numPopped.store( 0, std::memory_order_relaxed );
+		_numDropped.store( 0, std::memory_order_relaxed );
+		_numRejected.store( 0, std::memory_order_relaxed );
+		_highWaterMark.store( Size(), std::memory_order_relaxed );
+		_pushBlockedTime.store( 0, std::memory_order_relaxed );
+		_popBlockedTime.store( 0, std::memory_order_relaxed );
+	}
+
+	// Operations that need the consumer's end, resizing, or a lock per push.
+	// The asserts depend on T so that they only fire when used.
+
+	template <class... Args>
+	bool EmplaceFront( Args&&... args )
+	{
+		static_assert( sizeof( T ) == 0, "SpscQueue: Items can only be pushed at the back." );
+		return false;
+	}
+
+	bool PushFront( const T& item )
+	{
+		static_assert( sizeof( T ) == 0, "SpscQueue: Items can only be pushed at the back." );
+		return false;
+	}
+
+	bool TryPopBack( T& item )
+	{
+		static_assert( sizeof( T ) == 0, "SpscQueue: Items can only be popped from the front." );
+		return false;
+	}
+
+	bool WaitPopBack( T& item )
+	{
+		static_assert( sizeof( T ) == 0, "SpscQueue: Items can only be popped from the front." );
+		return false;
+	}
+
+	void SetMaxSize( size_t maxSize )
+	{
+		static_assert( sizeof( T ) == 0, "SpscQueue: Capacity is fixed at construction." );
+	}
+
+	void AddListener( QueueListener* listener, unsigned int tag )
+	{
+		static_assert( sizeof( T ) == 0, "SpscQueue: Listeners are not supported." );
+	}
+
+	void RemoveListener( QueueListener* listener )
+	{
+		static_assert( sizeof( T ) == 0, "SpscQueue: Listeners are not supported." );
+	}
+
+private:
+
+	typedef boost::chrono::steady_clock Clock;
+
+	/*! \brief A cell holds the item at position p while its sequence is
+	 * p + 1, and is free for position p while it is p. */
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		typename std::aligned_storage<sizeof( T ), std::alignment_of<T>::value>::type storage;
+		T* Get() { return reinterpret_cast<T*>( &storage ); }
+	};
+
+	static const size_t CacheLineSize = 64;
+
+	const size_t _capacity;
+	std::vector<Cell> _cells;
+	std::atomic<OverflowPolicy> _policy;
+
+	// Next position to pop. Claimed by compare and swap, since the producer
+	// also pops to drop the oldest item
+	char _pad0[CacheLineSize];
+	std::atomic<size_t> _head;
+	char _pad1[CacheLineSize - sizeof( std::atomic<size_t> )];
+
+	// Producer-owned index
+	std::atomic<size_t> _tail;
+	char _pad2[CacheLineSize - sizeof( std::atomic<size_t> )];
+
+	std::atomic<unsigned int> _numWaiting;
+	std::atomic<bool> _live;
+	Mutex _waitMutex;
+	ConditionVariable _changed;
+
+	// Each counter has a single writer
+	std::atomic<size_t> _numPushed;
+	std::atomic<size_t> _numPopped;
+	std::atomic<size_t> _numDropped;
+	std::atomic<size_t> _numRejected;
+	std::atomic<size_t> _highWaterMark;
+	std::atomic<double> _pushBlockedTime;
+	std::atomic<double> _popBlockedTime;
+
+	static Clock::time_point ToDeadline( double timeout )
+	{
+		return Clock::now() + boost::chrono::duration_cast<Clock::duration>(
+		           boost::chrono::duration<double>( timeout ) );
+	}
+
+	static void Increment( std::atomic<size_t>& counter )
+	{
+		counter.store( counter.load( std::memory_order_relaxed ) + 1,
+		               std::memory_order_relaxed );
+	}
+
+	static void AddTime( std::atomic<double>& counter, const Clock::time_point& start )
+	{
+		double dt = boost::chrono::duration<double>( Clock::now() - start ).count();
+		counter.store( counter.load( std::memory_order_relaxed ) + dt,
+		               std::memory_order_relaxed );
+	}
+
+	bool HasContents() const
+	{
+		return _head.load() != _tail.load();
+	}
+
+	/*! \brief Whether the producer's next cell is free. Producer only. */
+	bool HasSpace() const
+	{
+		size_t tail = _tail.load( std::memory_order_relaxed );
+		return _cells[tail % _capacity].sequence.load( std::memory_order_acquire ) == tail;
+	}
+
+	/*! \brief Claims the oldest item and moves it into item, or destroys it
+	 * if item is null. Returns false if there is none. */
+	bool Claim( T* item )
+	{
+		size_t head = _head.load( std::memory_order_relaxed );
+		Cell* cell;
+		while( true )
+		{
+			cell = &_cells[head % _capacity];
+			size_t sequence = cell->sequence.load( std::memory_order_acquire );
+			if( sequence == head + 1 )
+			{
+				if( _head.compare_exchange_weak( head, head + 1, std::memory_order_relaxed ) )
+				{
+					break;
+				}
+			}
+			else if( sequence < head + 1 ) { return false; }
+			else { head = _head.load( std::memory_order_relaxed ); }
+		}
+
+		T* ptr = cell->Get();
+		if( item ) { *item = std::move( *ptr ); }
+		ptr->~T();
+		cell->sequence.store( head + _capacity, std::memory_order_release );
+		return true;
+	}
+
+	template <class... Args>
+	bool Insert( const Clock::time_point* deadline, Args&&... args )
+	{
+		if( !_live.load() ) { return false; }
+
+		size_t tail = _tail.load( std::memory_order_relaxed );
+		Cell& cell = _cells[tail % _capacity];
+		if( cell.sequence.load( std::memory_order_acquire ) != tail )
+		{
+			OverflowPolicy policy = deadline ? OVERFLOW_BLOCK : _policy.load( std::memory_order_relaxed );
+			switch( policy )
+			{
+				case OVERFLOW_DROP_OLDEST:
+					// The cell frees once the consumer finishes an item it
+					// already claimed, so this spins for at most one move
+					while( cell.sequence.load( std::memory_order_acquire ) != tail )
+					{
+						if( Claim( nullptr ) ) { Increment( _numDropped ); }
+						else { CpuRelax(); }
+					}
+					break;
+				case OVERFLOW_REJECT:
+					Increment( _numRejected );
+					throw std::overflow_error( "SpscQueue: Queue is full." );
+				case OVERFLOW_BLOCK:
+				{
+					Clock::time_point start = Clock::now();
+					bool ok = WaitFor( &ThreadsafeQueue::HasSpace, deadline );
+					AddTime( _pushBlockedTime, start );
+					if( !ok ) { return false; }
+					break;
+				}
+				default:
+					Increment( _numDropped );
+					return false;
+			}
+		}
+
+		new ( cell.Get() ) T( std::forward<Args>( args )... );
+		cell.sequence.store( tail + 1, std::memory_order_release );
+		_tail.store( tail + 1, std::memory_order_release );
+
+		// The consumer may have popped since, so this never overestimates
+		Increment( _numPushed );
+		size_t size = tail + 1 - _head.load( std::memory_order_acquire );
+		if( size > _highWaterMark.load( std::memory_order_relaxed ) )
+		{
+			_highWaterMark.store( size, std::memory_order_relaxed );
+		}
+		NotifyWaiters();
+		return true;
+	}
+
+	bool WaitPop( T& item, const Clock::time_point* deadline )
+	{
+		if( TryPopFront( item ) ) { return true; }
+
+		Clock::time_point start = Clock::now();
+		bool ok = false;
+		while( WaitFor( &ThreadsafeQueue::HasContents, deadline ) )
+		{
+			if( TryPopFront( item ) )
+			{
+				ok = true;
+				break;
+			}
+		}
+		AddTime( _popBlockedTime, start );
+		return ok;
+	}
+
+	/*! \brief Parks until the predicate holds, the deadline passes, or the
+	 * queue is killed. Returns whether the predicate holds. */
+	bool WaitFor( bool (ThreadsafeQueue::*pred)() const,
+	              const Clock::time_point* deadline )
+	{
+		WriteLock lock( _waitMutex );
+		_numWaiting.fetch_add( 1 );
+		// Pairs with the fence in NotifyWaiters
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		while( _live.load() && !(this->*pred)() )
+		{
+			if( !deadline ) { _changed.wait( lock ); }
+			else if( _changed.wait_until( lock, *deadline ) == boost::cv_status::timeout )
+			{
+				break;
+			}
+		}
+		_numWaiting.fetch_sub( 1 );
+		return _live.load() && (this->*pred)();
+	}
+
+	void NotifyWaiters()
+	{
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		if( _numWaiting.load() == 0 ) { return; }
+		WriteLock lock( _waitMutex );
+		_changed.notify_all();
+	}
+
+	ThreadsafeQueue( const ThreadsafeQueue& other );
+	ThreadsafeQueue& operator=( const ThreadsafeQueue& other );
+};
+
+/*! \brief Shorthand for the single-producer/single-consumer queue. */
+template <class T>
+using SpscQueue = ThreadsafeQueue<T, SpscRing>;
+
+}
@@ -1,16 +1,26 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
 #include <boost/thread/thread.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/recursive_mutex.hpp>
 #include <boost/thread/lockable_adapter.hpp>
 
+#include "argus_utils/ArgusConfig.h"
+#include "argus_utils/synchronization/ProfiledMutex.h"
+
 namespace argus
 {
 
 // TODO Move semaphore into here?
 
+// Configure with ARGUS_PROFILE_LOCKS to record contention at every argus::Mutex
+#ifdef ARGUS_PROFILE_LOCKS
+typedef ProfiledSharedMutex Mutex;
+#else
 typedef boost::shared_mutex Mutex;
+#endif
 typedef boost::shared_lock<Mutex> ReadLock;
 typedef boost::unique_lock<Mutex> WriteLock;
 
@@ -19,6 +29,112 @@ typedef boost::unique_lock<RecursiveMutex> RecursiveLock;
 
 typedef boost::condition_variable_any ConditionVariable;
 
+/*! \brief Hints to the CPU that we are busy-waiting. */
+inline void CpuRelax()
+{
+#if defined( __i386__ ) || defined( __x86_64__ )
+	__builtin_ia32_pause();
+#endif
+}
+
+/*! \brief A mutex that does nothing, for objects used from a single thread. */
+class NullMutex
+{
+public:
+	void lock() {}
+	bool try_lock() { return true; }
+	void unlock() {}
+};
+
+/*! \brief A test-and-test-and-set spinlock for short, write-heavy critical
+ * sections. Never sleeps, so should not be held across blocking calls. */
+class SpinMutex
+{
+public:
+
+	SpinMutex() : _locked( false ) {}
+
+	void lock()
+	{
+		while( _locked.exchange( true, std::memory_order_acquire ) )
+		{
+			while( _locked.load( std::memory_order_relaxed ) )
+			{
+				CpuRelax();
+			}
+		}
+	}
+
+	bool try_lock()
+	{
+		return !_locked.load( std::memory_order_relaxed ) &&
+		       !_locked.exchange( true, std::memory_order_acquire );
+	}
+
+	void unlock()
+	{
+		_locked.store( false, std::memory_order_release );
+	}
+
+private:
+
+	std::atomic<bool> _locked;
+
+	SpinMutex( const SpinMutex& other );
+	SpinMutex& operator=( const SpinMutex& other );
+};
+
+/*! \brief Lock policies select the mutex and lock types of the synchronized
+ * argus classes at compile time. Each provides Mutex, ReadLock and WriteLock
+ * typedefs. Policies with an exclusive mutex take a full lock for reads. */
+template <typename ExclusiveMutex>
+struct ExclusiveLockPolicy
+{
+	typedef ExclusiveMutex Mutex;
+	typedef boost::unique_lock<Mutex> ReadLock;
+	typedef boost::unique_lock<Mutex> WriteLock;
+};
+
+/*! \brief Compiles locking out entirely. Only for single-threaded use. */
+typedef ExclusiveLockPolicy<NullMutex> NullLockPolicy;
+
+/*! \brief Busy-waits instead of sleeping. For short, contended sections. */
+typedef ExclusiveLockPolicy<SpinMutex> SpinLockPolicy;
+
+/*! \brief A plain std::mutex. Cheaper than a reader-writer lock when
+ * accesses are mostly writes. */
+typedef ExclusiveLockPolicy<std::mutex> StdLockPolicy;
+
+/*! \brief Reader-writer locking, the argus default. */
+struct SharedLockPolicy
+{
+	typedef argus::Mutex Mutex;
+	typedef argus::ReadLock ReadLock;
+	typedef argus::WriteLock WriteLock;
+};
+
+/*! \brief Reader-writer locking that records contention per lock site,
+ * regardless of ARGUS_PROFILE_LOCKS. */
+struct ProfiledLockPolicy
+{
+	typedef ProfiledSharedMutex Mutex;
+	typedef boost::shared_lock<Mutex> ReadLock;
+	typedef boost::unique_lock<Mutex> WriteLock;
+};
+
+typedef SharedLockPolicy DefaultLockPolicy;
+
+/*! \brief Identifies a source registered with a synchronizer or throttler
+ * by its dense registration index, so that per-message calls index an array
+ * instead of looking up the source key. Only valid for the object that
+ * returned it. A distinct type so that it cannot collide with integer keys. */
+struct SourceHandle
+{
+	unsigned int index;
+
+	explicit SourceHandle( unsigned int i = 0 ) : index( i ) {}
+};
+
 template<template<typename> class Lock, typename Lockable>
 void CheckLockOwnership( const Lock<Lockable>& lock, const Lockable* lockable )
 {
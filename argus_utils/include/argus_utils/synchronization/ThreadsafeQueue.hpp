@@ -2,12 +2,53 @@
 
 #include <memory>
 #include <deque>
+#include <iterator>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/chrono.hpp>
 
 #include "argus_utils/synchronization/SynchronizationTypes.h"
 
 namespace argus
 {
 
+/*! \brief What a size-limited queue does when an item is pushed while full. */
+enum OverflowPolicy
+{
+	OVERFLOW_DROP_OLDEST, // Drop an item from the opposite end
+	OVERFLOW_DROP_NEWEST, // Discard the item being pushed
+	OVERFLOW_BLOCK,       // Wait for a consumer to make room
+	OVERFLOW_REJECT       // Throw std::overflow_error
+};
+
+/*! \brief Running counters for a ThreadsafeQueue. Times are in seconds. */
+struct QueueStatistics
+{
+	size_t numPushed;
+	size_t numPopped;
+	size_t numDropped;
+	size_t numRejected;
+	size_t highWaterMark;
+	double pushBlockedTime;
+	double popBlockedTime;
+
+	QueueStatistics()
+	: numPushed( 0 ), numPopped( 0 ), numDropped( 0 ), numRejected( 0 ),
+	  highWaterMark( 0 ), pushBlockedTime( 0 ), popBlockedTime( 0 ) {}
+};
+
+/*! \brief Receives a call whenever an item is pushed to a queue it is
+ * attached to, such as a QueueSelector. Called with the queue locked, so it
+ * must not call back into the queue. */
+class QueueListener
+{
+public:
+
+	virtual ~QueueListener() {}
+	virtual void OnPush( unsigned int tag ) = 0;
+};
+
 /*! \brief A mutex-wrapped container that supports size limiting. */
 template <class T,
           template<typename,typename> class Container = std::deque >
@@ -18,8 +59,13 @@ public:
 	typedef T DataType;
 	typedef Container<T, typename std::allocator<T> > ContainerType;
 
-	ThreadsafeQueue( size_t maxSize = 0 )
-	: _maxSize( maxSize ), _live(true) {}
+	ThreadsafeQueue( size_t maxSize = 0,
+	                 OverflowPolicy policy = OVERFLOW_DROP_OLDEST )
+	: _live( true ), _maxSize( maxSize ), _policy( policy ),
+	  _numBlockedPushers( 0 )
+	{
+		NameLock( _mutex, "ThreadsafeQueue" );
+	}
 
 	~ThreadsafeQueue()
 	{
@@ -29,88 +75,151 @@ public:
 	// Allows blocked threads to quit
 	void Kill()
 	{
+		WriteLock lock( _mutex );
 		_live = false;
 		_hasContents.notify_all();
+		_hasSpace.notify_all();
 		_isEmpty.notify_all();
 	}
 
+	/*! \brief Calls listener->OnPush( tag ) after every push. */
+	void AddListener( QueueListener* listener, unsigned int tag )
+	{
+		WriteLock lock( _mutex );
+		_listeners.push_back( Listener( listener, tag ) );
+	}
+
+	void RemoveListener( QueueListener* listener )
+	{
+		WriteLock lock( _mutex );
+		for( size_t i = _listeners.size(); i > 0; --i )
+		{
+			if( _listeners[i-1].first == listener )
+			{
+				_listeners.erase( _listeners.begin() + i - 1 );
+			}
+		}
+	}
+
 	void SetMaxSize( size_t maxSize )
 	{
+		WriteLock lock( _mutex );
 		_maxSize = maxSize;
+		_hasSpace.notify_all();
 	}
 
-	template< class... Args>
-	void EmplaceFront( Args&&... args )
+	void SetOverflowPolicy( OverflowPolicy policy )
 	{
 		WriteLock lock( _mutex );
-		_items.emplace_front( args... );
-		if( _maxSize > 0 && _items.size() > _maxSize ) { _items.pop_back(); }
-		_hasContents.notify_one();
+		_policy = policy;
+		_hasSpace.notify_all();
 	}
 
+	/*! \brief Constructs an item at the front. Returns false if the item was
+	 * dropped, or the queue was killed while waiting for room. */
 	template< class... Args>
-	void EmplaceBack( Args&&... args )
+	bool EmplaceFront( Args&&... args )
 	{
 		WriteLock lock( _mutex );
-		_items.emplace_back( args... );
-		if( _maxSize > 0 && _items.size() > _maxSize ) { _items.pop_front(); }
-		_hasContents.notify_one();
+		return Insert( lock, true, nullptr, std::forward<Args>( args )... );
 	}
 
-	void PushFront( const T& item )
+	/*! \brief Constructs an item at the back. Returns false if the item was
+	 * dropped, or the queue was killed while waiting for room. */
+	template< class... Args>
+	bool EmplaceBack( Args&&... args )
 	{
 		WriteLock lock( _mutex );
-		_items.push_front( item );
-		if( _maxSize > 0 && _items.size() > _maxSize ) { _items.pop_back(); }
-		_hasContents.notify_one();
+		return Insert( lock, false, nullptr, std::forward<Args>( args )... );
+	}
+
+	bool PushFront( const T& item )
+	{
+		return EmplaceFront( item );
+	}
+
+	bool PushFront( T&& item )
+	{
+		return EmplaceFront( std::move( item ) );
+	}
+
+	bool PushBack( const T& item )
+	{
+		return EmplaceBack( item );
 	}
-	
-	void PushBack( const T& item)
+
+	bool PushBack( T&& item )
+	{
+		return EmplaceBack( std::move( item ) );
+	}
+
+	/*! \brief Pushes onto the back, waiting at most timeout seconds for room
+	 * if full. Returns false on timeout, or if the item was dropped. Items
+	 * are never dropped from the front while waiting. */
+	template <class Item>
+	bool WaitPushFor( Item&& item, double timeout )
 	{
 		WriteLock lock( _mutex );
-		_items.push_back( item );
-		if( _maxSize > 0 && _items.size() > _maxSize ) { _items.pop_front(); }
-		_hasContents.notify_one();
+		Clock::time_point deadline = ToDeadline( timeout );
+		return Insert( lock, false, &deadline, std::forward<Item>( item ) );
 	}
-	
-	void WaitPopFront( T& item )
+
+	/*! \brief Pushes a range of items onto the back under a single lock.
+	 * Use std::make_move_iterator to move the items in. Returns the number
+	 * of items inserted. */
+	template <class InputIt>
+	size_t PushRange( InputIt first, InputIt last )
 	{
 		WriteLock lock( _mutex );
-		while( _live && _items.empty() )
+		size_t num = 0;
+		for( ; first != last; ++first )
 		{
-			_hasContents.wait( lock );
+			if( Insert( lock, false, nullptr, *first ) ) { ++num; }
+			if( !_live ) { break; }
 		}
+		return num;
+	}
 
-		if( !_live ) { return; }
+	/*! \brief Waits for an item and moves it out of the front. Returns false
+	 * if the queue was killed while waiting. */
+	bool WaitPopFront( T& item )
+	{
+		WriteLock lock( _mutex );
+		if( !WaitContents( lock, nullptr ) ) { return false; }
 
-		item = _items.front();
+		item = std::move( _items.front() );
 		_items.pop_front();
-		
-		if( _items.empty() )
-		{
-			_isEmpty.notify_all();
-		}
+		NotifyPopped( 1 );
+		return true;
 	}
-	
-	void WaitPopBack( T& item )
+
+	/*! \brief Waits for an item and moves it out of the back. Returns false
+	 * if the queue was killed while waiting. */
+	bool WaitPopBack( T& item )
 	{
 		WriteLock lock( _mutex );
-		while( _live && _items.empty() )
-		{
-			_hasContents.wait( lock );
-		}
+		if( !WaitContents( lock, nullptr ) ) { return false; }
 
-		if( !_live ) { return; }
-		
-		item = _items.back();
-		_items.pop_back();	
-		
-		if( _items.empty() )
-		{
-			_isEmpty.notify_all();
-		}
+		item = std::move( _items.back() );
+		_items.pop_back();
+		NotifyPopped( 1 );
+		return true;
+	}
+
+	/*! \brief Waits at most timeout seconds for an item and moves it out of
+	 * the front. Returns false on timeout or if the queue was killed. */
+	bool WaitPopFor( T& item, double timeout )
+	{
+		WriteLock lock( _mutex );
+		Clock::time_point deadline = ToDeadline( timeout );
+		if( !WaitContents( lock, &deadline ) ) { return false; }
+
+		item = std::move( _items.front() );
+		_items.pop_front();
+		NotifyPopped( 1 );
+		return true;
 	}
-	
+
 	bool TryPopFront( T& item )
 	{
 		WriteLock lock( _mutex );
@@ -118,49 +227,71 @@ public:
 		{
 			return false;
 		}
-		item = _items.front();
+		item = std::move( _items.front() );
 		_items.pop_front();
-		
-		if( _items.empty() )
-		{
-			_isEmpty.notify_all();
-		}
+		NotifyPopped( 1 );
 		return true;
 	}
-	
+
 	bool TryPopBack( T& item )
 	{
 		WriteLock lock( _mutex );
-		while( _items.empty() )
-		{
-			return false;
-		}
-		item = _items.back();
-		_items.pop_back();	
-		
 		if( _items.empty() )
 		{
-			_isEmpty.notify_all();
+			return false;
 		}
+		item = std::move( _items.back() );
+		_items.pop_back();
+		NotifyPopped( 1 );
 		return true;
 	}
-	
+
+	/*! \brief Moves up to n items from the front onto the back of out, in
+	 * queue order, under a single lock. Returns the number of items moved. */
+	template <class OutContainer>
+	size_t PopUpTo( size_t n, OutContainer& out )
+	{
+		WriteLock lock( _mutex );
+		return MoveFront( n, out );
+	}
+
+	/*! \brief Moves all items onto the back of out under a single lock.
+	 * Returns the number of items moved. */
+	template <class OutContainer>
+	size_t PopAll( OutContainer& out )
+	{
+		WriteLock lock( _mutex );
+		return MoveFront( _items.size(), out );
+	}
+
+	/*! \brief Waits for at least one item, then moves all items onto the back
+	 * of out. Returns the number of items moved, which is zero only if the
+	 * queue was killed while waiting. */
+	template <class OutContainer>
+	size_t WaitPopAll( OutContainer& out )
+	{
+		WriteLock lock( _mutex );
+		if( !WaitContents( lock, nullptr ) ) { return 0; }
+		return MoveFront( _items.size(), out );
+	}
+
 	size_t Size() const
 	{
 		WriteLock lock( _mutex );
 		return _items.size();
 	}
-	
+
 	bool IsEmpty() const
 	{
 		return Size() == 0;
 	}
-	
+
 	void Clear()
 	{
 		WriteLock lock( _mutex );
 		_items.clear();
 		_isEmpty.notify_all();
+		_hasSpace.notify_all();
 	}
 
 	/*! \brief Wait for this queue to be empty. */
@@ -176,21 +307,167 @@ public:
 	void WaitHasContents()
 	{
 		WriteLock lock( _mutex );
-		while( _live && _items.empty() )
-		{
-			_hasContents.wait( lock );
-		}
+		WaitContents( lock, nullptr );
+	}
+
+	QueueStatistics GetStatistics() const
+	{
+		WriteLock lock( _mutex );
+		return _stats;
+	}
+
+	void ResetStatistics()
+	{
+		WriteLock lock( _mutex );
+		_stats = QueueStatistics();
+		_stats.highWaterMark = _items.size();
 	}
 
 protected:
 
+	typedef boost::chrono::steady_clock Clock;
+	typedef std::pair<QueueListener*, unsigned int> Listener;
+
 	mutable Mutex _mutex;
 
 	bool _live;
 	size_t _maxSize;
+	OverflowPolicy _policy;
+	unsigned int _numBlockedPushers;
 	ContainerType _items;
 	ConditionVariable _hasContents;
+	ConditionVariable _hasSpace;
 	ConditionVariable _isEmpty;
+	QueueStatistics _stats;
+	std::vector<Listener> _listeners;
+
+	static Clock::time_point ToDeadline( double timeout )
+	{
+		return Clock::now() + boost::chrono::duration_cast<Clock::duration>(
+		           boost::chrono::duration<double>( timeout ) );
+	}
+
+	static double SecondsSince( const Clock::time_point& start )
+	{
+		return boost::chrono::duration<double>( Clock::now() - start ).count();
+	}
+
+	bool IsFull() const
+	{
+		return _maxSize > 0 && _items.size() >= _maxSize;
+	}
+
+	/*! \brief Inserts an item according to the overflow policy. A deadline
+	 * forces blocking behavior, with a limit on the wait. */
+	template< class... Args>
+	bool Insert( WriteLock& lock, bool front, const Clock::time_point* deadline,
+	             Args&&... args )
+	{
+		if( !_live ) { return false; }
+
+		OverflowPolicy policy = deadline ? OVERFLOW_BLOCK : _policy;
+		if( IsFull() )
+		{
+			switch( policy )
+			{
+				case OVERFLOW_DROP_NEWEST:
+					++_stats.numDropped;
+					return false;
+				case OVERFLOW_REJECT:
+					++_stats.numRejected;
+					throw std::overflow_error( "ThreadsafeQueue: Queue is full." );
+				case OVERFLOW_BLOCK:
+					if( !WaitSpace( lock, deadline ) ) { return false; }
+					break;
+				default:
+					break;
+			}
+		}
+
+		if( front ) { _items.emplace_front( std::forward<Args>( args )... ); }
+		else { _items.emplace_back( std::forward<Args>( args )... ); }
+		++_stats.numPushed;
+
+		if( _maxSize > 0 && _items.size() > _maxSize )
+		{
+			if( front ) { _items.pop_back(); }
+			else { _items.pop_front(); }
+			++_stats.numDropped;
+		}
+		if( _items.size() > _stats.highWaterMark )
+		{
+			_stats.highWaterMark = _items.size();
+		}
+
+		_hasContents.notify_one();
+		for( size_t i = 0; i < _listeners.size(); ++i )
+		{
+			_listeners[i].first->OnPush( _listeners[i].second );
+		}
+		return true;
+	}
+
+	bool WaitSpace( WriteLock& lock, const Clock::time_point* deadline )
+	{
+		Clock::time_point start = Clock::now();
+		++_numBlockedPushers;
+		while( _live && IsFull() )
+		{
+			if( !deadline ) { _hasSpace.wait( lock ); }
+			else if( _hasSpace.wait_until( lock, *deadline ) == boost::cv_status::timeout )
+			{
+				break;
+			}
+		}
+		--_numBlockedPushers;
+		_stats.pushBlockedTime += SecondsSince( start );
+		return _live && !IsFull();
+	}
+
+	bool WaitContents( WriteLock& lock, const Clock::time_point* deadline )
+	{
+		if( _live && !_items.empty() ) { return true; }
+
+		Clock::time_point start = Clock::now();
+		while( _live && _items.empty() )
+		{
+			if( !deadline ) { _hasContents.wait( lock ); }
+			else if( _hasContents.wait_until( lock, *deadline ) == boost::cv_status::timeout )
+			{
+				break;
+			}
+		}
+		_stats.popBlockedTime += SecondsSince( start );
+		return _live && !_items.empty();
+	}
+
+	template <class OutContainer>
+	size_t MoveFront( size_t n, OutContainer& out )
+	{
+		if( n > _items.size() ) { n = _items.size(); }
+		typename ContainerType::iterator last = _items.begin();
+		std::advance( last, n );
+		out.insert( out.end(),
+		            std::make_move_iterator( _items.begin() ),
+		            std::make_move_iterator( last ) );
+		_items.erase( _items.begin(), last );
+		NotifyPopped( n );
+		return n;
+	}
+
+	void NotifyPopped( size_t n )
+	{
+		_stats.numPopped += n;
+		if( _numBlockedPushers > 0 && n > 0 )
+		{
+			if( n == 1 ) { _hasSpace.notify_one(); }
+			else { _hasSpace.notify_all(); }
+		}
+		if( _items.empty() )
+		{
+			_isEmpty.notify_all();
+		}
+	}
 
 };
 
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "argus_utils/synchronization/WorkerPool.h"
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace argus
+{
+
+/*! \brief Dispatch metrics for a single timer. Jitter is the delay from a
+ * firing's scheduled time to when its job starts on a worker, in seconds. */
+struct TimerStatistics
+{
+	unsigned long numFired;
+	unsigned long numSkipped; // Firings dropped because the job was still running
+	double meanJitter;
+	double rmsJitter;
+	double maxJitter;
+
+	TimerStatistics();
+};
+
+/*! \brief Runs periodic and one-shot jobs on a WorkerPool from a single
+ * driver thread, replacing a ros::Timer and callback queue round trip per
+ * task. Timers live in a hierarchical timing wheel, so adding and cancelling
+ * are O(1) regardless of the number of timers, and the driver only wakes for
+ * ticks that have timers due or cascading. With no timers it sleeps until
+ * one is added.
+ *
+ * Jobs are submitted with their scheduled time as the WorkerPool deadline,
+ * so they run ahead of normal work. Periodic timers fire at a fixed rate
+ * without drift. A firing is skipped if the previous run of the same timer
+ * has not finished, so slow jobs never pile up.
+ */
+class TimerWheel
+{
+public:
+
+	typedef std::shared_ptr<TimerWheel> Ptr;
+	typedef unsigned long TimerId;
+	typedef WorkerPool::Job Job;
+	typedef WorkerPool::Clock Clock;
+
+	/*! \brief Creates a wheel that dispatches onto the pool, with the given
+	 * tick resolution in seconds. Timers are rounded up to the next tick. */
+	TimerWheel( WorkerPool& pool, double resolution = 0.001 );
+
+	/*! \brief Creates a wheel that dispatches onto WorkerPool::Global(). */
+	explicit TimerWheel( double resolution = 0.001 );
+
+	/*! \brief Stops the driver thread. Jobs already dispatched still run. */
+	~TimerWheel();
+
+	/*! \brief Starts the driver thread. Timers may be added before or after. */
+	void Start();
+
+	/*! \brief Stops the driver thread and waits for it to return. Timers are
+	 * kept, and resume firing at the next call to Start(). */
+	void Stop();
+
+	/*! \brief Adds a job that runs every period seconds, first after delay
+	 * seconds, or after one period if delay is negative. */
+	TimerId AddPeriodic( const Job& job, double period, double delay = -1 );
+
+	/*! \brief Adds a job that runs once after delay seconds. */
+	TimerId AddOneShot( const Job& job, double delay );
+
+	/*! \brief Removes a timer. Returns false if it does not exist, such as a
+	 * one-shot that has already fired. A run in progress is not interrupted. */
+	bool Cancel( TimerId id );
+
+	/*! \brief Returns the number of active timers. */
+	unsigned int NumTimers() const;
+
+	/*! \brief Returns the metrics for a timer. Throws std::invalid_argument
+	 * if the timer does not exist. */
+	TimerStatistics GetStatistics( TimerId id ) const;
+
+	void ResetStatistics( TimerId id );
+
+protected:
+
+	typedef boost::unique_lock<boost::mutex> Lock;
+
+	static const unsigned int SlotBits = 8;
+	static const unsigned int NumSlots = 1 << SlotBits;
+	static const unsigned int NumLevels = 4;
+
+	/*! \brief Counters shared by a timer and its dispatched jobs, so that
+	 * jobs in flight may outlive the timer. Times are in nanoseconds. */
+	struct TimerStats
+	{
+		std::atomic<bool> running;
+		std::atomic<unsigned long> numFired;
+		std::atomic<unsigned long> numSkipped;
+		std::atomic<unsigned long> jitterSum;
+		std::atomic<double> jitterSqSum; // In seconds^2
+		std::atomic<unsigned long> maxJitter;
+
+		TimerStats();
+		void Reset();
+		void Record( unsigned long jitterNs );
+	};
+
+	/*! \brief Wraps a timer's job to measure its jitter when it starts.
+	 * Holds the job by pointer so that it fits inline in a WorkerPool::Job. */
+	struct TimerJob
+	{
+		std::shared_ptr<Job> job;
+		std::shared_ptr<TimerStats> stats;
+		Clock::time_point scheduled;
+
+		void operator()();
+	};
+
+	/*! \brief Links for the intrusive circular slot lists. */
+	struct Link
+	{
+		Link* prev;
+		Link* next;
+	};
+
+	struct Timer : public Link
+	{
+		TimerId id;
+		unsigned long expires; // Tick to fire at
+		Clock::time_point deadline;
+		Clock::duration period; // Zero for one-shots
+		std::shared_ptr<Job> job;
+		std::shared_ptr<TimerStats> stats;
+	};
+
+	WorkerPool& _pool;
+	const Clock::duration _resolution;
+	const Clock::time_point _start;
+
+	mutable boost::mutex _mutex;
+	boost::condition_variable _changed;
+	std::shared_ptr<boost::thread> _driver;
+	bool _running;
+
+	Link _slots[NumLevels][NumSlots];
+	unsigned long _currentTick; // Next tick to process
+	unsigned long _wakeTick; // Tick the driver is sleeping until, max if none
+	TimerId _nextId;
+	std::unordered_map<TimerId, Timer*> _timers;
+
+	TimerId Add( const Job& job, double delay, double period );
+	unsigned long TickOf( const Clock::time_point& time ) const;
+	unsigned long CurrentTick() const;
+	void Insert( Timer* timer );
+	static void Unlink( Timer* timer );
+	void Cascade( unsigned int level );
+	void ProcessTick( std::vector<TimerJob>& due );
+	unsigned long NextWakeTick() const;
+	void DriverLoop();
+
+private:
+
+	TimerWheel( const TimerWheel& other );
+	TimerWheel& operator=( const TimerWheel& other );
+};
+
+}
@@ -1,62 +1,317 @@
 #pragma once
 
 #include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/function.hpp>
+#include <boost/chrono.hpp>
 
 #include "argus_utils/synchronization/Semaphore.h"
+#include "argus_utils/synchronization/InplaceFunction.hpp"
+#include "argus_utils/synchronization/PoolAllocator.hpp"
 
-#include <queue>
+#include <atomic>
+#include <deque>
+#include <future>
+#include <memory>
+#include <vector>
 
-namespace argus 
+namespace YAML
 {
+class Node;
+}
 
-/*! \brief An asynchronous worker thread pool. Threads are not created
- * until specified, so construction is fast. */
+namespace argus
+{
+
+/*! \brief Scheduling classes for WorkerPool jobs. Each class has a latency
+ * target that sets the deadline of jobs submitted with it. */
+enum JobPriority
+{
+	PRIORITY_CRITICAL, // Runs before any other queued work
+	PRIORITY_NORMAL,
+	PRIORITY_BULK      // Runs when idle, or once it has waited its latency target
+};
+
+/*! \brief A snapshot of WorkerPool metrics since the last reset. Times are
+ * in seconds. Histogram bucket 0 counts times under 1 us, bucket i counts
+ * times in [2^(i-1), 2^i) us, and the last bucket also counts anything longer. */
+struct WorkerPoolStatistics
+{
+	static const unsigned int NumBuckets = 24;
+
+	/*! \brief Returns the upper edge of a histogram bucket in seconds. */
+	static double BucketUpperBound( unsigned int i );
+
+	double elapsed;
+	unsigned int numWorkers;
+	unsigned int queueDepth;
+	unsigned int peakQueueDepth;
+	unsigned long numCompleted;
+	double meanQueueTime;
+	double meanRunTime;
+	std::vector<unsigned long> queueTimeHistogram;
+	std::vector<unsigned long> runTimeHistogram;
+	std::vector<double> workerUtilization; // Busy fraction of each active worker
+
+	WorkerPoolStatistics();
+};
+
+/*! \brief An asynchronous work-stealing thread pool. Each worker owns a job
+ * deque, and idle workers steal from the others, so submissions do not all
+ * contend on one lock. Threads are not created until specified, so
+ * construction is fast.
+ *
+ * With autoscaling enabled, the pool starts at its minimum size and adds a
+ * worker whenever jobs wait longer than a target, up to its maximum size.
+ * Workers idle for longer than a timeout retire, down to the minimum.
+ * NOTE Submitting and waiting on jobs is synchronized, but setting the number
+ * of workers is not!
+ */
 class WorkerPool {
 public:
 
 	typedef std::shared_ptr<WorkerPool> Ptr;
-	typedef boost::function<void()> Job;
+	/*! \brief Jobs capturing up to 64 bytes are stored inline, and larger
+	 * ones in pooled memory, so submitting a job does not call malloc. */
+	typedef InplaceFunction<void(), 64> Job;
+	typedef boost::chrono::steady_clock Clock;
 
-	/*! \brief Creates a pool with the specified target number of workers. 
+	/*! \brief Creates a pool with the specified target number of workers.
 	 * Workers are not created until StartWorkers() is called. */
 	WorkerPool( unsigned int n = 4 );
-		
+
 	/*! \brief Stops all threads and waits for them to return. */
 	~WorkerPool();
-	
-	/*! \brief Sets the number of workers to initialize. */
+
+	/*! \brief Sets the number of workers to initialize. Takes effect at the
+	 * next call to StartWorkers(). */
 	void SetNumWorkers( unsigned int n );
-	
-	/*! \brief Adds a job to the worker queue and wakes workers. */
+
+	/*! \brief Returns the target number of workers. */
+	unsigned int GetNumWorkers() const;
+
+	/*! \brief Enables resizing between minWorkers and maxWorkers while
+	 * running. A worker is added when a job waits longer than targetQueueTime
+	 * seconds, or when every worker is busy and more jobs are queued than there
+	 * are workers. A worker idle for idleTimeout seconds retires. Takes effect
+	 * at the next call to StartWorkers(), and overrides SetNumWorkers(). */
+	void SetAutoscaling( unsigned int minWorkers, unsigned int maxWorkers,
+	                     double targetQueueTime = 0.005, double idleTimeout = 5.0 );
+
+	/*! \brief Reverts to the fixed number of workers from SetNumWorkers().
+	 * Takes effect at the next call to StartWorkers(). */
+	void DisableAutoscaling();
+
+	/*! \brief Returns the number of worker threads currently running. */
+	unsigned int GetNumActiveWorkers() const;
+
+	/*! \brief Reads settings from YAML. Fields are all optional:
+	 * num_workers:   Number of worker threads
+	 * min_workers:   Enables autoscaling with this minimum, see SetAutoscaling
+	 * max_workers:   Autoscaling maximum, defaults to num_workers
+	 * target_queue_time: Autoscaling queue time target in seconds
+	 * idle_timeout:  Seconds before an idle autoscaled worker retires
+	 * cpu_affinity:  List of cores to pin workers to, see SetCpuAffinity
+	 * scratch_size:  Bytes of scratch memory per worker, see SetScratchSize */
+	void Initialize( const YAML::Node& props );
+
+	/*! \brief Pins worker i to core cores[i % cores.size()] when workers are
+	 * started. Leaving it empty, the default, leaves workers unpinned. Cores
+	 * removed from scheduling with isolcpus may be listed explicitly. */
+	void SetCpuAffinity( const std::vector<unsigned int>& cores );
+
+	/*! \brief Returns the cores this process may run on. Excludes cores
+	 * isolated with isolcpus unless the process was started on them. */
+	static std::vector<unsigned int> GetAvailableCpus();
+
+	/*! \brief Sets the bytes of scratch memory each worker allocates when
+	 * started. Each worker allocates and zeroes its own buffer after being
+	 * pinned, so on NUMA machines the first-touch policy places it on the
+	 * worker's node. Defaults to 0. */
+	void SetScratchSize( size_t bytes );
+
+	/*! \brief Returns the calling worker's scratch memory, aligned to a
+	 * cache line, or nullptr when not called from a worker job. */
+	static void* GetScratch();
+	static size_t GetScratchSize();
+
+	/*! \brief Returns the process-wide pool shared by argus utilities, so
+	 * that several components in one node do not oversubscribe the cores.
+	 * Started on first use with one worker per hardware thread. Components
+	 * that need isolation from other work should own a pool instead. */
+	static WorkerPool& Global();
+
+	/*! \brief Configures the global pool, see Initialize(). Throws
+	 * std::runtime_error if Global() has already started it. */
+	static void InitializeGlobal( const YAML::Node& props );
+	static void SetGlobalNumWorkers( unsigned int n );
+
+	/*! \brief Adds a job to a worker queue and wakes a sleeping worker. Jobs
+	 * enqueued from a worker thread go to that worker's own queue. */
 	void EnqueueJob( Job job );
 
-	/*! \brief Creates the target number of worker threads and assigns
-	 * them to the task queue. */
+	/*! \brief Adds a job to the scheduling lane for its priority. Lane jobs
+	 * are run earliest-deadline-first, where the deadline is the enqueue time
+	 * plus the priority's latency target. Any lane job whose deadline is as
+	 * urgent as that of a fresh normal job runs ahead of plain jobs, so bulk
+	 * work runs once it has aged, and is never starved. */
+	void EnqueueJob( Job job, JobPriority priority );
+
+	/*! \brief Adds a job to the scheduling lanes with an explicit deadline. */
+	void EnqueueJobBy( Job job, const Clock::time_point& deadline );
+
+	/*! \brief Sets the latency target in seconds for a priority. Defaults
+	 * are 0 for critical, 0.01 for normal and 0.5 for bulk. */
+	void SetLaneLatency( JobPriority priority, double latency );
+
+	/*! \brief Adds a job and returns a future that carries its return value,
+	 * or the exception it threw. */
+	template <typename Func>
+	std::future<typename std::result_of<Func()>::type> EnqueueTask( Func func )
+	{
+		typedef typename std::result_of<Func()>::type Result;
+		TaskRunner<Result> runner;
+		runner.task = std::make_shared<std::packaged_task<Result()> >( func );
+		std::future<Result> result = runner.task->get_future();
+		EnqueueJob( runner );
+		return result;
+	}
+
+	/*! \brief Creates the target number of worker threads, or the minimum
+	 * number if autoscaling, and assigns them to the task queues. */
 	void StartWorkers();
-	
+
 	/*! \brief Stops all workers and waits for them to return. */
 	void StopWorkers();
 
 	/*! \brief Block until all current jobs are complete. */
 	void WaitOnJobs();
-	
+
+	/*! \brief Returns the number of jobs queued but not yet started. */
+	unsigned int NumPending() const;
+
+	/*! \brief Enables timing of jobs, which costs two clock reads per job.
+	 * Enabled by default. Queue depth is always tracked. */
+	void SetStatisticsEnabled( bool enable );
+
+	/*! \brief Returns the metrics accumulated since the last reset. */
+	WorkerPoolStatistics GetStatistics() const;
+
+	void ResetStatistics();
+
 protected:
 
 	typedef boost::unique_lock< boost::shared_mutex > Lock;
+	typedef boost::unique_lock< boost::mutex > QueueLock;
+
+	// packaged_task is move-only, but Job must be copyable
+	template <typename Result>
+	struct TaskRunner
+	{
+		std::shared_ptr<std::packaged_task<Result()> > task;
+		void operator()() { (*task)(); }
+	};
+
+	struct QueuedJob
+	{
+		Job job;
+		Clock::time_point enqueued; // Unset if statistics are disabled
+	};
+
+	/*! \brief Metrics for jobs run by one worker. Only that worker writes
+	 * them, so the counters see no contention. Times are in nanoseconds. */
+	struct WorkerStats
+	{
+		std::atomic<unsigned long> numJobs;
+		std::atomic<unsigned long> queueTime;
+		std::atomic<unsigned long> runTime;
+		std::atomic<unsigned long> queueHistogram[WorkerPoolStatistics::NumBuckets];
+		std::atomic<unsigned long> runHistogram[WorkerPoolStatistics::NumBuckets];
+
+		WorkerStats();
+		void Reset();
+		void Record( const Clock::duration& queued, const Clock::duration& run );
+	};
+
+	/*! \brief A single worker's job deque. The owner pops from the front and
+	 * thieves steal from the back. Deque blocks are recycled through
+	 * PooledMemory as the deque grows and shrinks. */
+	struct WorkerQueue
+	{
+		boost::mutex mutex;
+		std::deque< QueuedJob, PoolAllocator<QueuedJob> > jobs;
+		WorkerStats stats;
+	};
+
+	/*! \brief A job in the deadline-ordered lanes. */
+	struct LaneJob
+	{
+		Clock::time_point deadline;
+		unsigned long sequence; // Keeps equal deadlines in FIFO order
+		QueuedJob item;
+
+		// Orders std heaps so that the earliest deadline is on top
+		bool operator<( const LaneJob& other ) const
+		{
+			if( deadline != other.deadline ) { return deadline > other.deadline; }
+			return sequence > other.sequence;
+		}
+	};
 
 	boost::shared_mutex _mutex;
 	unsigned int _numWorkers;
-	std::queue<Job> _jobQueue;
-	
-	unsigned int _activeThreads;
-	boost::condition_variable_any _hasJobs;
-	boost::condition_variable_any _threadsDone;
-	
-	boost::thread_group _workerThreads;
-	
-	void WorkerLoop();
+	std::vector<unsigned int> _cpuAffinity;
+	size_t _scratchSize;
+	std::vector< std::shared_ptr<WorkerQueue> > _queues; // Replaced under _mutex and _statsMutex
+	std::vector< std::shared_ptr<boost::thread> > _workerThreads; // One per queue, null if unused
+
+	// Autoscaling settings, applied at StartWorkers
+	bool _autoscale;
+	unsigned int _minWorkers;
+	unsigned int _maxWorkers;
+	Clock::duration _targetQueueTime;
+	Clock::duration _idleTimeout;
+
+	// Workers run on queues [0, _numActive). Queues beyond that are drained
+	// by stealing, so jobs left there by a retiring worker still run
+	std::atomic<bool> _scaling;
+	std::atomic<unsigned int> _numActive;
+	std::atomic<long> _lastGrowth; // Nanoseconds since clock epoch
+
+	std::atomic<unsigned int> _nextQueue; // Round-robin target for outside submissions
+	std::atomic<unsigned int> _numPending; // Queued but not started
+	std::atomic<unsigned int> _numOutstanding; // Queued or running
+	std::atomic<unsigned int> _numSleeping;
+
+	// Heap of deadline-ordered lane jobs
+	boost::mutex _laneMutex;
+	std::vector<LaneJob> _laneJobs;
+	unsigned long _laneSequence;
+	std::atomic<unsigned int> _numLaneJobs;
+	Clock::duration _laneLatencies[3];
+
+	std::atomic<bool> _statsEnabled;
+	std::atomic<unsigned int> _peakPending;
+	mutable boost::mutex _statsMutex;
+	Clock::time_point _statsStart;
+
+	// Only used to park idle workers and WaitOnJobs callers
+	boost::mutex _sleepMutex;
+	boost::condition_variable _hasJobs;
+	boost::condition_variable _jobsDone;
+
+	void ResizeQueues( unsigned int n );
+	void PinWorker( unsigned int index );
+	void NotifyWorkers();
+	void AddPending();
+	bool PopLaneJob( bool onlyUrgent, QueuedJob& item );
+	bool PopJob( unsigned int index, QueuedJob& item );
+	void RunJob( unsigned int index, QueuedJob& item );
+	void FinishJob();
+	void MaybeGrow();
+	bool TryRetire( unsigned int index );
+	void WorkerLoop( unsigned int index );
 
 };
 
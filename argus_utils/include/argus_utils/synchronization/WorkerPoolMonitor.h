@@ -0,0 +1,45 @@
+#pragma once
+
+#include <ros/ros.h>
+
+#include "argus_utils/synchronization/WorkerPool.h"
+#include "argus_msgs/WorkerPoolStatistics.h"
+
+namespace argus
+{
+
+argus_msgs::WorkerPoolStatistics StatisticsToMsg( const WorkerPoolStatistics& stats );
+
+/*! \brief Periodically publishes the statistics of a WorkerPool. The pool
+ * must outlive the monitor. */
+class WorkerPoolMonitor
+{
+public:
+
+	WorkerPoolMonitor( WorkerPool& pool );
+
+	/*! \brief Starts publishing on the topic at the specified rate in Hz. If
+	 * resetOnPublish is set, each message only covers the last period. */
+	void Initialize( ros::NodeHandle& nh,
+	                 const std::string& topic,
+	                 double rate,
+	                 bool resetOnPublish = false );
+
+	/*! \brief Reads publish_rate from the private handle and publishes on
+	 * the topic from the node handle. */
+	void Initialize( ros::NodeHandle& nh,
+	                 ros::NodeHandle& ph,
+	                 const std::string& topic = "worker_pool_statistics",
+	                 bool resetOnPublish = false );
+
+private:
+
+	WorkerPool& _pool;
+	bool _resetOnPublish;
+	ros::Publisher _statsPub;
+	ros::Timer _publishTimer;
+
+	void TimerCallback( const ros::TimerEvent& event );
+};
+
+}
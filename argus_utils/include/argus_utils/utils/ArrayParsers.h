@@ -20,7 +20,7 @@ GetParam( const S& src,
 	t.reserve( temp.size() );
 	for( unsigned int i = 0; i < temp.size(); i++ )
 	{
-		t.emplace_back( t[i] );
+		t.emplace_back( temp[i] );
 	}
 	return true;
 }
@@ -46,7 +46,7 @@ GetParam( const S& src,
 			                          std::to_string(temp[i]) +
 			                          " as unsigned." );
 		}
-		t.emplace_back( t[i] );
+		t.emplace_back( temp[i] );
 	}
 	return true;
 }
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace argus
+{
+
+/*! \brief A binary heap over items 0 to N-1 with changeable keys. Items are
+ * addressed by index, so the key of any item can be set or removed in
+ * O(log N), and the top item read in O(1). The item whose key comes first
+ * under Compare is on top, so the default is a min-heap.
+ */
+template <typename Compare = std::less<double> >
+class IndexedHeap
+{
+public:
+
+	typedef double KeyType;
+
+	IndexedHeap( const Compare& comp = Compare() )
+	: _comp( comp ) {}
+
+	/*! \brief Sets the number of items. Removed items leave the heap. */
+	void Resize( unsigned int n )
+	{
+		for( unsigned int i = n; i < _positions.size(); ++i )
+		{
+			Remove( i );
+		}
+		_positions.resize( n, NotInHeap );
+		_keys.resize( n );
+	}
+
+	unsigned int NumItems() const
+	{
+		return _positions.size();
+	}
+
+	/*! \brief Returns the number of items in the heap. */
+	unsigned int Size() const
+	{
+		return _heap.size();
+	}
+
+	bool Empty() const
+	{
+		return _heap.empty();
+	}
+
+	bool Contains( unsigned int i ) const
+	{
+		return _positions.at( i ) != NotInHeap;
+	}
+
+	/*! \brief Returns the top item. The heap must not be empty. */
+	unsigned int Top() const
+	{
+		return _heap.front();
+	}
+
+	KeyType TopKey() const
+	{
+		return _keys[_heap.front()];
+	}
+
+	KeyType GetKey( unsigned int i ) const
+	{
+		return _keys.at( i );
+	}
+
+	/*! \brief Inserts item i with the key, or updates its key. */
+	void Set( unsigned int i, const KeyType& key )
+	{
+		if( i >= _positions.size() )
+		{
+			throw std::out_of_range( "IndexedHeap: Item index out of range." );
+		}
+
+		_keys[i] = key;
+		if( _positions[i] == NotInHeap )
+		{
+			_positions[i] = _heap.size();
+			_heap.push_back( i );
+		}
+		Restore( _positions[i] );
+	}
+
+	/*! \brief Removes item i from the heap, if it is in it. */
+	void Remove( unsigned int i )
+	{
+		unsigned int pos = _positions.at( i );
+		if( pos == NotInHeap ) { return; }
+
+		Place( _heap.back(), pos );
+		_heap.pop_back();
+		_positions[i] = NotInHeap;
+		if( pos < _heap.size() ) { Restore( pos ); }
+	}
+
+	void Clear()
+	{
+		for( unsigned int i = 0; i < _heap.size(); ++i )
+		{
+			_positions[_heap[i]] = NotInHeap;
+		}
+		_heap.clear();
+	}
+
+	/*! \brief Appends to out the items whose keys do not come after bound,
+	 * in heap order. Only visits those items and their children, so costs
+	 * O(M) for M items found. */
+	void FindUpTo( const KeyType& bound, std::vector<unsigned int>& out ) const
+	{
+		CountUpTo( bound, std::numeric_limits<unsigned int>::max(), &out );
+	}
+
+	/*! \brief Counts the items whose keys do not come after bound, stopping
+	 * at limit. Costs O(limit) at most. */
+	unsigned int CountUpTo( const KeyType& bound, unsigned int limit,
+	                        std::vector<unsigned int>* out = nullptr ) const
+	{
+		if( _heap.empty() || limit == 0 ) { return 0; }
+
+		// Depth-first, pruning subtrees whose roots come after the bound
+		unsigned int count = 0;
+		_stack.clear();
+		_stack.push_back( 0 );
+		while( !_stack.empty() && count < limit )
+		{
+			unsigned int pos = _stack.back();
+			_stack.pop_back();
+			unsigned int item = _heap[pos];
+			if( _comp( bound, _keys[item] ) ) { continue; }
+
+			++count;
+			if( out ) { out->push_back( item ); }
+			unsigned int child = 2 * pos + 1;
+			if( child + 1 < _heap.size() ) { _stack.push_back( child + 1 ); }
+			if( child < _heap.size() ) { _stack.push_back( child ); }
+		}
+		return count;
+	}
+
+private:
+
+	static const unsigned int NotInHeap = std::numeric_limits<unsigned int>::max();
+
+	Compare _comp;
+	std::vector<unsigned int> _heap; // Items in heap order
+	std::vector<unsigned int> _positions; // Heap position of each item
+	std::vector<KeyType> _keys;
+	mutable std::vector<unsigned int> _stack; // Reused by CountUpTo
+
+	bool Before( unsigned int a, unsigned int b ) const
+	{
+		return _comp( _keys[_heap[a]], _keys[_heap[b]] );
+	}
+
+	void Place( unsigned int item, unsigned int pos )
+	{
+		_heap[pos] = item;
+		_positions[item] = pos;
+	}
+
+	void Swap( unsigned int a, unsigned int b )
+	{
+		unsigned int itemA = _heap[a];
+		Place( _heap[b], a );
+		Place( itemA, b );
+	}
+
+	/*! \brief Moves the item at pos up or down to its place. */
+	void Restore( unsigned int pos )
+	{
+		while( pos > 0 && Before( pos, ( pos - 1 ) / 2 ) )
+		{
+			Swap( pos, ( pos - 1 ) / 2 );
+			pos = ( pos - 1 ) / 2;
+		}
+
+		while( true )
+		{
+			unsigned int first = pos;
+			unsigned int left = 2 * pos + 1;
+			unsigned int right = left + 1;
+			if( left < _heap.size() && Before( left, first ) ) { first = left; }
+			if( right < _heap.size() && Before( right, first ) ) { first = right; }
+			if( first == pos ) { return; }
+			Swap( pos, first );
+			pos = first;
+		}
+	}
+};
+
+template <typename Compare>
+const unsigned int IndexedHeap<Compare>::NotInHeap;
+
+}
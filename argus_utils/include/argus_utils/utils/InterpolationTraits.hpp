@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdexcept>
+
+#include "argus_utils/utils/LinalgTypes.h"
+
+namespace argus
+{
+
+/*! \brief Customization point for interpolating between two data. Types
+ * that can be interpolated specialize this with IsInterpolable set and an
+ * Interpolate that returns the datum a fraction alpha of the way from a to
+ * b, where alpha is in [0, 1]. The default cannot interpolate.
+ */
+template <typename Data>
+struct InterpolationTraits
+{
+	static const bool IsInterpolable = false;
+
+	static Data Interpolate( const Data& a, const Data& b, double alpha )
+	{
+		throw std::logic_error( "InterpolationTraits: Type cannot be interpolated." );
+	}
+};
+
+template <typename Data>
+const bool InterpolationTraits<Data>::IsInterpolable;
+
+/*! \brief Vectors interpolate linearly. */
+template <>
+struct InterpolationTraits<VectorType>
+{
+	static const bool IsInterpolable = true;
+
+	static VectorType Interpolate( const VectorType& a, const VectorType& b,
+	                               double alpha )
+	{
+		if( a.size() != b.size() )
+		{
+			throw std::invalid_argument( "InterpolationTraits: Vector sizes do not match." );
+		}
+		return a + alpha * ( b - a );
+	}
+};
+
+}
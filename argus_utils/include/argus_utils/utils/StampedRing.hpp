@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace argus
+{
+
+/*! \brief A contiguous ring buffer of (stamp, data) pairs kept sorted by
+ * stamp, for buffering timestamped messages without an allocation per
+ * message. Lookups by stamp are binary searches. Appending in stamp order
+ * and popping the oldest are O(1); inserting or erasing elsewhere shifts the
+ * shorter side. The ring doubles in size only when full, so callers that
+ * bound the size never allocate after warming up.
+ *
+ * Data must be default-constructible and assignable. Slots are reused in
+ * place, so popped data are kept until overwritten, and data that own
+ * memory, such as messages with vectors, reuse it when assigned.
+ */
+template <typename Data>
+class StampedRing
+{
+public:
+
+	typedef std::pair<double, Data> value_type;
+
+	StampedRing( size_t capacity = 0 )
+	: _data( capacity ), _start( 0 ), _size( 0 ) {}
+
+	size_t Size() const
+	{
+		return _size;
+	}
+
+	bool Empty() const
+	{
+		return _size == 0;
+	}
+
+	size_t Capacity() const
+	{
+		return _data.size();
+	}
+
+	/*! \brief Grows the storage to at least the capacity. */
+	void Reserve( size_t capacity )
+	{
+		if( capacity > _data.size() ) { Reallocate( capacity ); }
+	}
+
+	void Clear()
+	{
+		_start = 0;
+		_size = 0;
+	}
+
+	/*! \brief Returns the i-th oldest element. */
+	value_type& operator[]( size_t i )
+	{
+		return _data[Physical( i )];
+	}
+
+	const value_type& operator[]( size_t i ) const
+	{
+		return _data[Physical( i )];
+	}
+
+	value_type& Front() { return _data[_start]; }
+	const value_type& Front() const { return _data[_start]; }
+	value_type& Back() { return (*this)[_size - 1]; }
+	const value_type& Back() const { return (*this)[_size - 1]; }
+
+	/*! \brief Appends data with a stamp no earlier than the latest. */
+	void PushBack( double t, const Data& data )
+	{
+		value_type& slot = AppendSlot( t );
+		slot.second = data;
+		++_size;
+	}
+
+	void PushBack( double t, Data&& data )
+	{
+		value_type& slot = AppendSlot( t );
+		slot.second = std::move( data );
+		++_size;
+	}
+
+	/*! \brief Inserts data in stamp order. Returns false without inserting
+	 * if an element with the stamp already exists. */
+	bool Insert( double t, const Data& data )
+	{
+		size_t i = LowerBound( t );
+		if( i < _size && (*this)[i].first == t ) { return false; }
+		if( i == _size )
+		{
+			PushBack( t, data );
+			return true;
+		}
+
+		if( _size == _data.size() ) { Reallocate( std::max<size_t>( 2 * _data.size(), 4 ) ); }
+		++_size;
+		for( size_t j = _size - 1; j > i; --j )
+		{
+			std::swap( (*this)[j], (*this)[j - 1] );
+		}
+		(*this)[i].first = t;
+		(*this)[i].second = data;
+		return true;
+	}
+
+	void PopFront()
+	{
+		if( _size == 0 ) { return; }
+		_start = Physical( 1 );
+		--_size;
+	}
+
+	/*! \brief Removes the i-th oldest element. */
+	void Erase( size_t i )
+	{
+		if( i >= _size ) { return; }
+		if( i < _size / 2 )
+		{
+			for( size_t j = i; j > 0; --j )
+			{
+				std::swap( (*this)[j], (*this)[j - 1] );
+			}
+			PopFront();
+		}
+		else
+		{
+			for( size_t j = i; j + 1 < _size; ++j )
+			{
+				std::swap( (*this)[j], (*this)[j + 1] );
+			}
+			--_size;
+		}
+	}
+
+	/*! \brief Returns the index of the first element stamped at or after t,
+	 * or Size() if there is none. */
+	size_t LowerBound( double t ) const
+	{
+		size_t lo = 0;
+		size_t hi = _size;
+		while( lo < hi )
+		{
+			size_t mid = lo + ( hi - lo ) / 2;
+			if( (*this)[mid].first < t ) { lo = mid + 1; }
+			else { hi = mid; }
+		}
+		return lo;
+	}
+
+	/*! \brief Finds the element stamped closest to t, preferring the later
+	 * one on ties. Returns false if empty. */
+	bool FindClosest( double t, size_t& i ) const
+	{
+		if( _size == 0 ) { return false; }
+
+		size_t upper = LowerBound( t );
+		if( upper == _size ) { i = _size - 1; }
+		else if( upper == 0 || (*this)[upper].first == t ) { i = upper; }
+		else
+		{
+			size_t lower = upper - 1;
+			i = ( (*this)[upper].first - t > t - (*this)[lower].first ) ? lower : upper;
+		}
+		return true;
+	}
+
+private:
+
+	std::vector<value_type> _data;
+	size_t _start; // Physical index of the oldest element
+	size_t _size;
+
+	value_type& AppendSlot( double t )
+	{
+		if( _size > 0 && t < Back().first )
+		{
+			throw std::invalid_argument( "StampedRing: Stamps must be pushed in order." );
+		}
+		if( _size == _data.size() ) { Reallocate( std::max<size_t>( 2 * _data.size(), 4 ) ); }
+
+		value_type& slot = (*this)[_size];
+		slot.first = t;
+		return slot;
+	}
+
+	size_t Physical( size_t i ) const
+	{
+		i += _start;
+		return i < _data.size() ? i : i - _data.size();
+	}
+
+	void Reallocate( size_t capacity )
+	{
+		std::vector<value_type> data( capacity );
+		for( size_t i = 0; i < _size; ++i )
+		{
+			std::swap( data[i], (*this)[i] );
+		}
+		_data.swap( data );
+		_start = 0;
+	}
+};
+
+}
@@ -0,0 +1,272 @@
+#include "argus_utils/synchronization/ProfiledMutex.h"
+
+#include <boost/chrono.hpp>
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <map>
+
+namespace argus
+{
+
+namespace
+{
+
+typedef boost::chrono::steady_clock Clock;
+
+unsigned long NowNs()
+{
+	return boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+	           Clock::now().time_since_epoch() ).count();
+}
+
+double ToSeconds( unsigned long ns )
+{
+	return ns * 1E-9;
+}
+
+void UpdateMax( std::atomic<unsigned long>& max, unsigned long val )
+{
+	unsigned long curr = max.load( std::memory_order_relaxed );
+	while( val > curr &&
+	       !max.compare_exchange_weak( curr, val, std::memory_order_relaxed ) ) {}
+}
+
+bool CompareWaitTime( const LockSiteStatistics& a, const LockSiteStatistics& b )
+{
+	return a.waitTime > b.waitTime;
+}
+
+void WriteStatistics( std::ostream& os, const std::vector<LockSiteStatistics>& stats )
+{
+	os << "Lock site statistics (times in ms):" << std::endl;
+	os << std::left << std::setw( 40 ) << "site"
+	   << std::right << std::setw( 12 ) << "acquired"
+	   << std::setw( 12 ) << "contended"
+	   << std::setw( 12 ) << "wait"
+	   << std::setw( 12 ) << "max wait"
+	   << std::setw( 12 ) << "hold"
+	   << std::setw( 12 ) << "max hold" << std::endl;
+	for( unsigned int i = 0; i < stats.size(); ++i )
+	{
+		const LockSiteStatistics& s = stats[i];
+		os << std::left << std::setw( 40 ) << s.name
+		   << std::right << std::setw( 12 ) << s.numAcquisitions
+		   << std::setw( 12 ) << s.numContended
+		   << std::fixed << std::setprecision( 3 )
+		   << std::setw( 12 ) << 1E3 * s.waitTime
+		   << std::setw( 12 ) << 1E3 * s.maxWaitTime
+		   << std::setw( 12 ) << 1E3 * s.holdTime
+		   << std::setw( 12 ) << 1E3 * s.maxHoldTime << std::endl;
+	}
+}
+
+struct LockSiteRegistry
+{
+	typedef std::map<std::string, LockSite::Ptr> SiteMap;
+
+	boost::mutex mutex;
+	SiteMap sites;
+	bool dumpOnExit;
+
+	LockSiteRegistry()
+#ifdef ARGUS_PROFILE_LOCKS
+	: dumpOnExit( true ) {}
+#else
+	: dumpOnExit( false ) {}
+#endif
+
+	std::vector<LockSiteStatistics> GetStatistics()
+	{
+		boost::unique_lock<boost::mutex> lock( mutex );
+		std::vector<LockSiteStatistics> stats;
+		for( SiteMap::const_iterator iter = sites.begin(); iter != sites.end(); ++iter )
+		{
+			stats.push_back( iter->second->GetStatistics() );
+		}
+		std::sort( stats.begin(), stats.end(), &CompareWaitTime );
+		return stats;
+	}
+
+	~LockSiteRegistry()
+	{
+		if( dumpOnExit ) { WriteStatistics( std::cerr, GetStatistics() ); }
+	}
+};
+
+LockSiteRegistry& GetRegistry()
+{
+	static LockSiteRegistry registry;
+	return registry;
+}
+
+}
+
+LockSiteStatistics::LockSiteStatistics()
+: numAcquisitions( 0 ), numContended( 0 ), waitTime( 0 ), holdTime( 0 ),
+  maxWaitTime( 0 ), maxHoldTime( 0 ) {}
+
+LockSite::Ptr LockSite::Get( const std::string& name )
+{
+	LockSiteRegistry& registry = GetRegistry();
+	boost::unique_lock<boost::mutex> lock( registry.mutex );
+	LockSite::Ptr& site = registry.sites[name];
+	if( !site ) { site = std::make_shared<LockSite>( name ); }
+	return site;
+}
+
+LockSite::LockSite( const std::string& name )
+: _name( name ), _numAcquisitions( 0 ), _numContended( 0 ), _waitNs( 0 ),
+  _holdNs( 0 ), _maxWaitNs( 0 ), _maxHoldNs( 0 ) {}
+
+void LockSite::RecordAcquire( unsigned long waitNs, bool contended )
+{
+	_numAcquisitions.fetch_add( 1, std::memory_order_relaxed );
+	if( !contended ) { return; }
+	_numContended.fetch_add( 1, std::memory_order_relaxed );
+	_waitNs.fetch_add( waitNs, std::memory_order_relaxed );
+	UpdateMax( _maxWaitNs, waitNs );
+}
+
+void LockSite::RecordHold( unsigned long holdNs )
+{
+	_holdNs.fetch_add( holdNs, std::memory_order_relaxed );
+	UpdateMax( _maxHoldNs, holdNs );
+}
+
+LockSiteStatistics LockSite::GetStatistics() const
+{
+	LockSiteStatistics stats;
+	stats.name = _name;
+	stats.numAcquisitions = _numAcquisitions.load( std::memory_order_relaxed );
+	stats.numContended = _numContended.load( std::memory_order_relaxed );
+	stats.waitTime = ToSeconds( _waitNs.load( std::memory_order_relaxed ) );
+	stats.holdTime = ToSeconds( _holdNs.load( std::memory_order_relaxed ) );
+	stats.maxWaitTime = ToSeconds( _maxWaitNs.load( std::memory_order_relaxed ) );
+	stats.maxHoldTime = ToSeconds( _maxHoldNs.load( std::memory_order_relaxed ) );
+	return stats;
+}
+
+void LockSite::Reset()
+{
+	_numAcquisitions.store( 0 );
+	_numContended.store( 0 );
+	_waitNs.store( 0 );
+	_holdNs.store( 0 );
+	_maxWaitNs.store( 0 );
+	_maxHoldNs.store( 0 );
+}
+
+ProfiledSharedMutex::ProfiledSharedMutex()
+: _site( LockSite::Get( "unnamed" ) ), _numReaders( 0 ), _holdStart( 0 ) {}
+
+ProfiledSharedMutex::ProfiledSharedMutex( const std::string& name )
+: _site( LockSite::Get( name ) ), _numReaders( 0 ), _holdStart( 0 ) {}
+
+void ProfiledSharedMutex::SetName( const std::string& name )
+{
+	_site = LockSite::Get( name );
+}
+
+void ProfiledSharedMutex::lock()
+{
+	// Only time the wait if the fast path fails
+	if( _mutex.try_lock() )
+	{
+		Acquired( 0, false );
+		return;
+	}
+	unsigned long start = NowNs();
+	_mutex.lock();
+	Acquired( start, true );
+}
+
+bool ProfiledSharedMutex::try_lock()
+{
+	if( !_mutex.try_lock() ) { return false; }
+	Acquired( 0, false );
+	return true;
+}
+
+void ProfiledSharedMutex::unlock()
+{
+	unsigned long held = NowNs() - _holdStart.load( std::memory_order_relaxed );
+	_mutex.unlock();
+	_site->RecordHold( held );
+}
+
+void ProfiledSharedMutex::lock_shared()
+{
+	if( _mutex.try_lock_shared() )
+	{
+		AcquiredShared( 0, false );
+		return;
+	}
+	unsigned long start = NowNs();
+	_mutex.lock_shared();
+	AcquiredShared( start, true );
+}
+
+bool ProfiledSharedMutex::try_lock_shared()
+{
+	if( !_mutex.try_lock_shared() ) { return false; }
+	AcquiredShared( 0, false );
+	return true;
+}
+
+void ProfiledSharedMutex::unlock_shared()
+{
+	// The last reader out closes the hold interval
+	unsigned long held = 0;
+	bool last = _numReaders.fetch_sub( 1 ) == 1;
+	if( last ) { held = NowNs() - _holdStart.load( std::memory_order_relaxed ); }
+	_mutex.unlock_shared();
+	if( last ) { _site->RecordHold( held ); }
+}
+
+void ProfiledSharedMutex::Acquired( unsigned long start, bool contended )
+{
+	unsigned long now = NowNs();
+	_holdStart.store( now, std::memory_order_relaxed );
+	_site->RecordAcquire( contended ? now - start : 0, contended );
+}
+
+void ProfiledSharedMutex::AcquiredShared( unsigned long start, bool contended )
+{
+	unsigned long now = NowNs();
+	if( _numReaders.fetch_add( 1 ) == 0 )
+	{
+		_holdStart.store( now, std::memory_order_relaxed );
+	}
+	_site->RecordAcquire( contended ? now - start : 0, contended );
+}
+
+std::vector<LockSiteStatistics> GetLockStatistics()
+{
+	return GetRegistry().GetStatistics();
+}
+
+void ResetLockStatistics()
+{
+	LockSiteRegistry& registry = GetRegistry();
+	boost::unique_lock<boost::mutex> lock( registry.mutex );
+	for( LockSiteRegistry::SiteMap::iterator iter = registry.sites.begin();
+	     iter != registry.sites.end(); ++iter )
+	{
+		iter->second->Reset();
+	}
+}
+
+void DumpLockStatistics( std::ostream& os )
+{
+	WriteStatistics( os, GetRegistry().GetStatistics() );
+}
+
+void SetDumpLockStatisticsOnExit( bool enable )
+{
+	LockSiteRegistry& registry = GetRegistry();
+	boost::unique_lock<boost::mutex> lock( registry.mutex );
+	registry.dumpOnExit = enable;
+}
+
+}
@@ -4,34 +4,88 @@ namespace argus
 {
 
 Semaphore::Semaphore( int startCounter )
-	: counter( startCounter )
+	: counter( startCounter ), numWaiting( 0 ), numMultiWaiting( 0 )
 {}
 
 void Semaphore::Increment( int i )
 {
-	boost::unique_lock<Mutex> lock( mutex );
-	counter += i;
-	hasCounters.notify_all(); // TODO all or one?
+	counter.fetch_add( i );
+
+	// Seeing no waiters here means any new waiter will see our counters
+	int waiting = numWaiting.load();
+	if( waiting == 0 ) { return; }
+
+	// Waiters needing several counters may be passed over by notify_one,
+	// so all are woken to check. Read under the lock, which waiters hold
+	// from registering until they sleep.
+	Lock lock( mutex );
+	if( i >= waiting || numMultiWaiting.load() > 0 )
+	{
+		hasCounters.notify_all();
+		return;
+	}
+	for( int j = 0; j < i; ++j )
+	{
+		hasCounters.notify_one();
+	}
 }
 
 void Semaphore::Decrement( int i )
 {
-	boost::unique_lock<Mutex> lock( mutex );
-	
-	while( counter < i )
+	if( TryDecrement( i ) ) { return; }
+	WaitDecrement( i, nullptr );
+}
+
+bool Semaphore::TryDecrement( int i )
+{
+	int current = counter.load();
+	while( current >= i )
 	{
-		hasCounters.wait( lock );
+		if( counter.compare_exchange_weak( current, current - i ) )
+		{
+			return true;
+		}
 	}
-	counter = counter - i;
+	return false;
 }
 
-// TODO IncrementWait and DecrementWait
+bool Semaphore::DecrementFor( double timeout, int i )
+{
+	if( TryDecrement( i ) ) { return true; }
+
+	Clock::time_point deadline = Clock::now() +
+	    boost::chrono::duration_cast<Clock::duration>(
+	        boost::chrono::duration<double>( timeout ) );
+	return WaitDecrement( i, &deadline );
+}
 
 /*! \brief Returns how many counters are available. */
 int Semaphore::Query() const
 {
-	boost::shared_lock<Mutex> lock( mutex );
-	return counter;
+	return counter.load();
+}
+
+bool Semaphore::WaitDecrement( int i, const Clock::time_point* deadline )
+{
+	Lock lock( mutex );
+	++numWaiting;
+	if( i > 1 ) { ++numMultiWaiting; }
+	bool success = true;
+	while( !TryDecrement( i ) )
+	{
+		if( !deadline ) 
+		{ 
+			hasCounters.wait( lock ); 
+		}
+		else if( hasCounters.wait_until( lock, *deadline ) == boost::cv_status::timeout )
+		{
+			success = TryDecrement( i );
+			break;
+		}
+	}
+	if( i > 1 ) { --numMultiWaiting; }
+	--numWaiting;
+	return success;
 }
 	
 }
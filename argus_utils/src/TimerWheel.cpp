@@ -0,0 +1,394 @@
+#include "argus_utils/synchronization/TimerWheel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace argus
+{
+
+namespace
+{
+
+TimerWheel::Clock::duration ToDuration( double seconds )
+{
+	return boost::chrono::duration_cast<TimerWheel::Clock::duration>(
+	           boost::chrono::duration<double>( seconds ) );
+}
+
+unsigned long ToNanoseconds( const TimerWheel::Clock::duration& d )
+{
+	return boost::chrono::duration_cast<boost::chrono::nanoseconds>( d ).count();
+}
+
+}
+
+TimerStatistics::TimerStatistics()
+: numFired( 0 ), numSkipped( 0 ), meanJitter( 0 ), rmsJitter( 0 ), maxJitter( 0 ) {}
+
+TimerWheel::TimerStats::TimerStats()
+: running( false )
+{
+	Reset();
+}
+
+void TimerWheel::TimerStats::Reset()
+{
+	numFired.store( 0 );
+	numSkipped.store( 0 );
+	jitterSum.store( 0 );
+	jitterSqSum.store( 0 );
+	maxJitter.store( 0 );
+}
+
+void TimerWheel::TimerStats::Record( unsigned long jitterNs )
+{
+	// Runs of one timer never overlap, so there is a single writer
+	numFired.store( numFired.load( std::memory_order_relaxed ) + 1,
+	                std::memory_order_relaxed );
+	jitterSum.store( jitterSum.load( std::memory_order_relaxed ) + jitterNs,
+	                 std::memory_order_relaxed );
+	double jitter = jitterNs * 1E-9;
+	jitterSqSum.store( jitterSqSum.load( std::memory_order_relaxed ) + jitter * jitter,
+	                   std::memory_order_relaxed );
+	if( jitterNs > maxJitter.load( std::memory_order_relaxed ) )
+	{
+		maxJitter.store( jitterNs, std::memory_order_relaxed );
+	}
+}
+
+void TimerWheel::TimerJob::operator()()
+{
+	Clock::time_point start = Clock::now();
+	stats->Record( start > scheduled ? ToNanoseconds( start - scheduled ) : 0 );
+
+	// Clears the running flag even if the job throws
+	struct RunningGuard
+	{
+		std::atomic<bool>& running;
+		~RunningGuard() { running.store( false ); }
+	} guard = { stats->running };
+	(*job)();
+}
+
+TimerWheel::TimerWheel( WorkerPool& pool, double resolution )
+: _pool( pool ), _resolution( ToDuration( resolution ) ), _start( Clock::now() ),
+  _running( false ), _currentTick( 0 ), _wakeTick( 0 ), _nextId( 0 )
+{
+	if( _resolution <= Clock::duration::zero() )
+	{
+		throw std::invalid_argument( "TimerWheel: Resolution must be positive." );
+	}
+	for( unsigned int l = 0; l < NumLevels; ++l )
+	{
+		for( unsigned int s = 0; s < NumSlots; ++s )
+		{
+			_slots[l][s].prev = &_slots[l][s];
+			_slots[l][s].next = &_slots[l][s];
+		}
+	}
+}
+
+TimerWheel::TimerWheel( double resolution )
+: TimerWheel( WorkerPool::Global(), resolution ) {}
+
+TimerWheel::~TimerWheel()
+{
+	Stop();
+	typedef std::unordered_map<TimerId, Timer*>::iterator Iterator;
+	for( Iterator iter = _timers.begin(); iter != _timers.end(); ++iter )
+	{
+		delete iter->second;
+	}
+}
+
+void TimerWheel::Start()
+{
+	Lock lock( _mutex );
+	if( _driver ) { return; }
+	_running = true;
+	_driver = std::make_shared<boost::thread>( boost::bind( &TimerWheel::DriverLoop, this ) );
+}
+
+void TimerWheel::Stop()
+{
+	std::shared_ptr<boost::thread> driver;
+	{
+		Lock lock( _mutex );
+		_running = false;
+		_changed.notify_all();
+		driver.swap( _driver );
+	}
+	if( driver ) { driver->join(); }
+}
+
+TimerWheel::TimerId TimerWheel::AddPeriodic( const Job& job, double period, double delay )
+{
+	if( period <= 0 )
+	{
+		throw std::invalid_argument( "TimerWheel: Period must be positive." );
+	}
+	return Add( job, delay < 0 ? period : delay, period );
+}
+
+TimerWheel::TimerId TimerWheel::AddOneShot( const Job& job, double delay )
+{
+	return Add( job, std::max( delay, 0.0 ), 0 );
+}
+
+TimerWheel::TimerId TimerWheel::Add( const Job& job, double delay, double period )
+{
+	Timer* timer = new Timer;
+	timer->deadline = Clock::now() + ToDuration( delay );
+	timer->period = ToDuration( period );
+	timer->job = std::make_shared<Job>( job );
+	timer->stats = std::make_shared<TimerStats>();
+
+	Lock lock( _mutex );
+	// An empty wheel sleeps without a deadline, so skip the ticks it missed
+	if( _timers.empty() )
+	{
+		_currentTick = std::max( _currentTick, CurrentTick() );
+	}
+	timer->id = _nextId++;
+	timer->expires = TickOf( timer->deadline );
+	_timers[timer->id] = timer;
+	Insert( timer );
+
+	// Wake the driver if it is sleeping past this timer
+	if( timer->expires < _wakeTick ) { _changed.notify_all(); }
+	return timer->id;
+}
+
+bool TimerWheel::Cancel( TimerId id )
+{
+	Lock lock( _mutex );
+	std::unordered_map<TimerId, Timer*>::iterator iter = _timers.find( id );
+	if( iter == _timers.end() ) { return false; }
+	Unlink( iter->second );
+	delete iter->second;
+	_timers.erase( iter );
+	return true;
+}
+
+unsigned int TimerWheel::NumTimers() const
+{
+	Lock lock( _mutex );
+	return _timers.size();
+}
+
+TimerStatistics TimerWheel::GetStatistics( TimerId id ) const
+{
+	std::shared_ptr<TimerStats> stats;
+	{
+		Lock lock( _mutex );
+		std::unordered_map<TimerId, Timer*>::const_iterator iter = _timers.find( id );
+		if( iter == _timers.end() )
+		{
+			throw std::invalid_argument( "TimerWheel: Unknown timer." );
+		}
+		stats = iter->second->stats;
+	}
+
+	TimerStatistics out;
+	out.numFired = stats->numFired.load();
+	out.numSkipped = stats->numSkipped.load();
+	out.maxJitter = stats->maxJitter.load() * 1E-9;
+	if( out.numFired > 0 )
+	{
+		out.meanJitter = stats->jitterSum.load() * 1E-9 / out.numFired;
+		out.rmsJitter = std::sqrt( stats->jitterSqSum.load() / out.numFired );
+	}
+	return out;
+}
+
+void TimerWheel::ResetStatistics( TimerId id )
+{
+	Lock lock( _mutex );
+	std::unordered_map<TimerId, Timer*>::iterator iter = _timers.find( id );
+	if( iter == _timers.end() )
+	{
+		throw std::invalid_argument( "TimerWheel: Unknown timer." );
+	}
+	iter->second->stats->Reset();
+}
+
+unsigned long TimerWheel::TickOf( const Clock::time_point& time ) const
+{
+	if( time <= _start ) { return 0; }
+	// Round up so that timers never fire early
+	Clock::duration since = time - _start;
+	return ( since + _resolution - Clock::duration( 1 ) ) / _resolution;
+}
+
+unsigned long TimerWheel::CurrentTick() const
+{
+	// Only ticks that have fully started
+	return ( Clock::now() - _start ) / _resolution;
+}
+
+void TimerWheel::Insert( Timer* timer )
+{
+	// Anything overdue fires at the next processed tick
+	if( timer->expires < _currentTick ) { timer->expires = _currentTick; }
+
+	unsigned long delta = timer->expires - _currentTick;
+	unsigned int level = 0;
+	while( level < NumLevels - 1 && delta >= ( 1UL << ( SlotBits * ( level + 1 ) ) ) )
+	{
+		++level;
+	}
+	// Beyond the top level, park in the furthest slot and cascade from there
+	unsigned long maxDelta = ( 1UL << ( SlotBits * NumLevels ) ) - 1;
+	unsigned long expires = ( delta > maxDelta ) ? _currentTick + maxDelta : timer->expires;
+
+	Link& head = _slots[level][( expires >> ( SlotBits * level ) ) & ( NumSlots - 1 )];
+	timer->prev = head.prev;
+	timer->next = &head;
+	head.prev->next = timer;
+	head.prev = timer;
+}
+
+void TimerWheel::Unlink( Timer* timer )
+{
+	timer->prev->next = timer->next;
+	timer->next->prev = timer->prev;
+	timer->prev = timer;
+	timer->next = timer;
+}
+
+void TimerWheel::Cascade( unsigned int level )
+{
+	Link& head = _slots[level][( _currentTick >> ( SlotBits * level ) ) & ( NumSlots - 1 )];
+	while( head.next != &head )
+	{
+		Timer* timer = static_cast<Timer*>( head.next );
+		Unlink( timer );
+		Insert( timer );
+	}
+}
+
+void TimerWheel::ProcessTick( std::vector<TimerJob>& due )
+{
+	// Move timers down from higher levels when the lower level wraps
+	for( unsigned int level = 1; level < NumLevels; ++level )
+	{
+		if( ( _currentTick & ( ( 1UL << ( SlotBits * level ) ) - 1 ) ) != 0 ) { break; }
+		Cascade( level );
+	}
+
+	Link& head = _slots[0][_currentTick & ( NumSlots - 1 )];
+	Clock::time_point now = Clock::now();
+	while( head.next != &head )
+	{
+		Timer* timer = static_cast<Timer*>( head.next );
+		Unlink( timer );
+
+		if( timer->stats->running.exchange( true ) )
+		{
+			++timer->stats->numSkipped;
+		}
+		else
+		{
+			TimerJob job;
+			job.job = timer->job;
+			job.stats = timer->stats;
+			job.scheduled = timer->deadline;
+			due.push_back( job );
+		}
+
+		if( timer->period == Clock::duration::zero() )
+		{
+			_timers.erase( timer->id );
+			delete timer;
+			continue;
+		}
+
+		// Fixed rate, skipping any periods that were missed entirely
+		timer->deadline += timer->period;
+		if( timer->deadline <= now )
+		{
+			unsigned long missed = ( now - timer->deadline ) / timer->period + 1;
+			timer->deadline += missed * timer->period;
+			timer->stats->numSkipped += missed;
+		}
+		timer->expires = TickOf( timer->deadline );
+		Insert( timer );
+	}
+	++_currentTick;
+}
+
+unsigned long TimerWheel::NextWakeTick() const
+{
+	// Level 0 holds the timers due in the next NumSlots ticks
+	unsigned long next = std::numeric_limits<unsigned long>::max();
+	for( unsigned long tick = _currentTick; tick < _currentTick + NumSlots; ++tick )
+	{
+		const Link& head = _slots[0][tick & ( NumSlots - 1 )];
+		if( head.next != &head )
+		{
+			next = tick;
+			break;
+		}
+	}
+
+	// Higher levels only release timers when their slot cascades, so empty
+	// slots need no wake
+	for( unsigned int level = 1; level < NumLevels; ++level )
+	{
+		unsigned int shift = SlotBits * level;
+		unsigned long index = _currentTick >> shift;
+		for( unsigned long i = index; i <= index + NumSlots; ++i )
+		{
+			unsigned long tick = i << shift;
+			if( tick >= next ) { break; }
+			const Link& head = _slots[level][i & ( NumSlots - 1 )];
+			if( tick >= _currentTick && head.next != &head )
+			{
+				next = tick;
+				break;
+			}
+		}
+	}
+	return next;
+}
+
+void TimerWheel::DriverLoop()
+{
+	std::vector<TimerJob> due;
+	Lock lock( _mutex );
+	while( _running )
+	{
+		unsigned long nowTick = CurrentTick();
+		while( _currentTick <= nowTick )
+		{
+			ProcessTick( due );
+		}
+
+		if( !due.empty() )
+		{
+			lock.unlock();
+			for( unsigned int i = 0; i < due.size(); ++i )
+			{
+				_pool.EnqueueJobBy( due[i], due[i].scheduled );
+			}
+			due.clear();
+			lock.lock();
+			continue;
+		}
+
+		// Sleeps until a timer is added if there are none
+		_wakeTick = NextWakeTick();
+		if( _wakeTick == std::numeric_limits<unsigned long>::max() )
+		{
+			_changed.wait( lock );
+		}
+		else
+		{
+			_changed.wait_until( lock, _start + _wakeTick * _resolution );
+		}
+	}
+}
+
+}
@@ -1,11 +1,166 @@
 #include "argus_utils/synchronization/WorkerPool.h"
+#include "argus_utils/utils/ParamUtils.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
 
 namespace argus
 {
 
+namespace
+{
+// Lets EnqueueJob find the calling worker's own queue
+thread_local WorkerPool* tlsPool = nullptr;
+thread_local unsigned int tlsIndex = 0;
+thread_local void* tlsScratch = nullptr;
+thread_local size_t tlsScratchSize = 0;
+
+/*! \brief Cache-line aligned memory owned by one worker thread. */
+struct ScratchBuffer
+{
+	void* data;
+	size_t size;
+
+	ScratchBuffer( size_t n ) 
+	: data( nullptr ), size( 0 )
+	{
+		if( n == 0 ) { return; }
+		if( posix_memalign( &data, 64, n ) != 0 )
+		{
+			data = nullptr;
+			ROS_WARN_STREAM( "WorkerPool: Could not allocate " << n << " bytes of scratch." );
+			return;
+		}
+		// Touch every page from this thread so that they are placed locally
+		std::memset( data, 0, n );
+		size = n;
+	}
+
+	~ScratchBuffer()
+	{
+		free( data );
+	}
+};
+
+WorkerPool::Clock::duration ToDuration( double seconds )
+{
+	return boost::chrono::duration_cast<WorkerPool::Clock::duration>(
+	           boost::chrono::duration<double>( seconds ) );
+}
+
+double ToSeconds( const WorkerPool::Clock::duration& d )
+{
+	return boost::chrono::duration<double>( d ).count();
+}
+
+unsigned long ToNanoseconds( const WorkerPool::Clock::duration& d )
+{
+	return boost::chrono::duration_cast<boost::chrono::nanoseconds>( d ).count();
+}
+
+long NowNanoseconds()
+{
+	return ToNanoseconds( WorkerPool::Clock::now().time_since_epoch() );
+}
+
+/*! \brief The global pool, constructed on first use and stopped at exit. */
+struct GlobalPool
+{
+	boost::mutex mutex;
+	WorkerPool pool;
+	std::atomic<bool> started;
+
+	GlobalPool()
+	: pool( std::max( boost::thread::hardware_concurrency(), 1u ) ), started( false ) {}
+};
+
+GlobalPool& GetGlobalPool()
+{
+	static GlobalPool global;
+	return global;
+}
+
+/*! \brief Returns the unstarted global pool for configuration. */
+WorkerPool& ConfigureGlobalPool( boost::unique_lock<boost::mutex>& lock )
+{
+	GlobalPool& global = GetGlobalPool();
+	lock = boost::unique_lock<boost::mutex>( global.mutex );
+	if( global.started.load() )
+	{
+		throw std::runtime_error( "WorkerPool: Global pool must be configured before its first use." );
+	}
+	return global.pool;
+}
+
+unsigned int BucketIndex( unsigned long ns )
+{
+	unsigned long us = ns / 1000;
+	if( us == 0 ) { return 0; }
+	unsigned int i = 64 - __builtin_clzl( us );
+	return std::min( i, WorkerPoolStatistics::NumBuckets - 1 );
+}
+}
+
+WorkerPoolStatistics::WorkerPoolStatistics()
+: elapsed( 0 ), numWorkers( 0 ), queueDepth( 0 ), peakQueueDepth( 0 ),
+  numCompleted( 0 ), meanQueueTime( 0 ), meanRunTime( 0 ),
+  queueTimeHistogram( NumBuckets, 0 ), runTimeHistogram( NumBuckets, 0 ) {}
+
+double WorkerPoolStatistics::BucketUpperBound( unsigned int i )
+{
+	if( i + 1 >= NumBuckets ) { return std::numeric_limits<double>::infinity(); }
+	return std::ldexp( 1E-6, i );
+}
+
+WorkerPool::WorkerStats::WorkerStats()
+{
+	Reset();
+}
+
+void WorkerPool::WorkerStats::Reset()
+{
+	numJobs.store( 0 );
+	queueTime.store( 0 );
+	runTime.store( 0 );
+	for( unsigned int i = 0; i < WorkerPoolStatistics::NumBuckets; i++ )
+	{
+		queueHistogram[i].store( 0 );
+		runHistogram[i].store( 0 );
+	}
+}
+
+void WorkerPool::WorkerStats::Record( const Clock::duration& queued,
+                                      const Clock::duration& run )
+{
+	unsigned long queuedNs = ToNanoseconds( queued );
+	unsigned long runNs = ToNanoseconds( run );
+	numJobs.fetch_add( 1, std::memory_order_relaxed );
+	queueTime.fetch_add( queuedNs, std::memory_order_relaxed );
+	runTime.fetch_add( runNs, std::memory_order_relaxed );
+	queueHistogram[BucketIndex( queuedNs )].fetch_add( 1, std::memory_order_relaxed );
+	runHistogram[BucketIndex( runNs )].fetch_add( 1, std::memory_order_relaxed );
+}
+
 WorkerPool::WorkerPool( unsigned int n )
-: _numWorkers( n ), _activeThreads( 0 ) {}
-	
+: _numWorkers( n ), _scratchSize( 0 ), _autoscale( false ), _minWorkers( n ), _maxWorkers( n ),
+  _targetQueueTime( ToDuration( 0.005 ) ), _idleTimeout( ToDuration( 5.0 ) ),
+  _scaling( false ), _numActive( 0 ), _lastGrowth( 0 ),
+  _nextQueue( 0 ), _numPending( 0 ), _numOutstanding( 0 ), _numSleeping( 0 ),
+  _laneSequence( 0 ), _numLaneJobs( 0 ),
+  _statsEnabled( true ), _peakPending( 0 ), _statsStart( Clock::now() )
+{
+	_laneLatencies[PRIORITY_CRITICAL] = ToDuration( 0 );
+	_laneLatencies[PRIORITY_NORMAL] = ToDuration( 0.01 );
+	_laneLatencies[PRIORITY_BULK] = ToDuration( 0.5 );
+	ResizeQueues( n );
+}
+
 WorkerPool::~WorkerPool()
 {
 	StopWorkers();
@@ -13,75 +168,562 @@ WorkerPool::~WorkerPool()
 
 void WorkerPool::SetNumWorkers( unsigned int n )
 {
-	Lock lock( _mutex );	
+	Lock lock( _mutex );
 	_numWorkers = n;
 }
 
+unsigned int WorkerPool::GetNumWorkers() const
+{
+	return _numWorkers;
+}
+
+void WorkerPool::SetAutoscaling( unsigned int minWorkers, unsigned int maxWorkers,
+                                 double targetQueueTime, double idleTimeout )
+{
+	if( minWorkers == 0 || maxWorkers < minWorkers )
+	{
+		throw std::invalid_argument( "WorkerPool: Autoscaling requires 0 < min workers <= max workers." );
+	}
+	if( targetQueueTime < 0 || idleTimeout <= 0 )
+	{
+		throw std::invalid_argument( "WorkerPool: Autoscaling times must be positive." );
+	}
+
+	Lock lock( _mutex );
+	_autoscale = true;
+	_minWorkers = minWorkers;
+	_maxWorkers = maxWorkers;
+	_targetQueueTime = ToDuration( targetQueueTime );
+	_idleTimeout = ToDuration( idleTimeout );
+}
+
+void WorkerPool::DisableAutoscaling()
+{
+	Lock lock( _mutex );
+	_autoscale = false;
+}
+
+unsigned int WorkerPool::GetNumActiveWorkers() const
+{
+	return _numActive.load();
+}
+
+void WorkerPool::Initialize( const YAML::Node& props )
+{
+	unsigned int numWorkers;
+	if( GetParam( props, "num_workers", numWorkers ) )
+	{
+		SetNumWorkers( numWorkers );
+	}
+
+	std::vector<unsigned int> cores;
+	if( GetParam( props, "cpu_affinity", cores ) )
+	{
+		SetCpuAffinity( cores );
+	}
+
+	unsigned int scratchSize;
+	if( GetParam( props, "scratch_size", scratchSize ) )
+	{
+		SetScratchSize( scratchSize );
+	}
+
+	unsigned int minWorkers, maxWorkers;
+	if( GetParam( props, "min_workers", minWorkers ) )
+	{
+		double targetQueueTime, idleTimeout;
+		GetParam( props, "max_workers", maxWorkers, _numWorkers );
+		GetParam( props, "target_queue_time", targetQueueTime, 0.005 );
+		GetParam( props, "idle_timeout", idleTimeout, 5.0 );
+		SetAutoscaling( minWorkers, maxWorkers, targetQueueTime, idleTimeout );
+	}
+}
+
+void WorkerPool::SetCpuAffinity( const std::vector<unsigned int>& cores )
+{
+	Lock lock( _mutex );
+	_cpuAffinity = cores;
+}
+
+std::vector<unsigned int> WorkerPool::GetAvailableCpus()
+{
+	std::vector<unsigned int> cpus;
+	cpu_set_t set;
+	CPU_ZERO( &set );
+	if( sched_getaffinity( 0, sizeof( set ), &set ) != 0 )
+	{
+		throw std::runtime_error( "WorkerPool: Could not read process affinity." );
+	}
+	for( unsigned int i = 0; i < CPU_SETSIZE; i++ )
+	{
+		if( CPU_ISSET( i, &set ) ) { cpus.push_back( i ); }
+	}
+	return cpus;
+}
+
+void WorkerPool::SetScratchSize( size_t bytes )
+{
+	Lock lock( _mutex );
+	_scratchSize = bytes;
+}
+
+void* WorkerPool::GetScratch()
+{
+	return tlsScratch;
+}
+
+size_t WorkerPool::GetScratchSize()
+{
+	return tlsScratchSize;
+}
+
+WorkerPool& WorkerPool::Global()
+{
+	GlobalPool& global = GetGlobalPool();
+	if( !global.started.load( std::memory_order_acquire ) )
+	{
+		boost::unique_lock<boost::mutex> lock( global.mutex );
+		if( !global.started.load() )
+		{
+			global.pool.StartWorkers();
+			global.started.store( true, std::memory_order_release );
+		}
+	}
+	return global.pool;
+}
+
+void WorkerPool::InitializeGlobal( const YAML::Node& props )
+{
+	boost::unique_lock<boost::mutex> lock;
+	ConfigureGlobalPool( lock ).Initialize( props );
+}
+
+void WorkerPool::SetGlobalNumWorkers( unsigned int n )
+{
+	boost::unique_lock<boost::mutex> lock;
+	ConfigureGlobalPool( lock ).SetNumWorkers( n );
+}
+
 void WorkerPool::EnqueueJob( Job job )
 {
-	Lock lock( _mutex );	
-	_jobQueue.push( job );
-	_hasJobs.notify_one();
+	unsigned int index;
+	bool scaling = _scaling.load( std::memory_order_relaxed );
+	if( tlsPool == this ) { index = tlsIndex; }
+	else
+	{
+		unsigned int active = scaling ? _numActive.load() : 0;
+		if( active == 0 ) { active = _queues.size(); }
+		index = _nextQueue.fetch_add( 1 ) % active;
+	}
+
+	Clock::time_point enqueued;
+	if( scaling || _statsEnabled.load( std::memory_order_relaxed ) ) { enqueued = Clock::now(); }
+
+	// Count the job before it is visible so that it is never decremented early
+	++_numOutstanding;
+	AddPending();
+	WorkerQueue& queue = *_queues[index];
+	{
+		QueueLock lock( queue.mutex );
+		queue.jobs.push_back( QueuedJob() );
+		queue.jobs.back().job.swap( job );
+		queue.jobs.back().enqueued = enqueued;
+	}
+	NotifyWorkers();
+
+	// Long jobs may keep every worker from popping and measuring queue time
+	if( scaling && _numSleeping.load() == 0 && _numPending.load() > _numActive.load() )
+	{
+		MaybeGrow();
+	}
+}
+
+void WorkerPool::EnqueueJob( Job job, JobPriority priority )
+{
+	Clock::duration latency;
+	{
+		QueueLock lock( _laneMutex );
+		latency = _laneLatencies[priority];
+	}
+	EnqueueJobBy( std::move( job ), Clock::now() + latency );
+}
+
+void WorkerPool::EnqueueJobBy( Job job, const Clock::time_point& deadline )
+{
+	Clock::time_point enqueued;
+	if( _scaling.load( std::memory_order_relaxed ) ||
+	    _statsEnabled.load( std::memory_order_relaxed ) )
+	{
+		enqueued = Clock::now();
+	}
+
+	++_numOutstanding;
+	AddPending();
+	{
+		QueueLock lock( _laneMutex );
+		_laneJobs.push_back( LaneJob() );
+		LaneJob& lane = _laneJobs.back();
+		lane.deadline = deadline;
+		lane.sequence = _laneSequence++;
+		lane.item.job.swap( job );
+		lane.item.enqueued = enqueued;
+		std::push_heap( _laneJobs.begin(), _laneJobs.end() );
+		++_numLaneJobs;
+	}
+	NotifyWorkers();
+}
+
+void WorkerPool::SetLaneLatency( JobPriority priority, double latency )
+{
+	if( latency < 0 )
+	{
+		throw std::invalid_argument( "WorkerPool: Lane latency must be non-negative." );
+	}
+	QueueLock lock( _laneMutex );
+	_laneLatencies[priority] = ToDuration( latency );
 }
 
 void WorkerPool::StartWorkers()
 {
-	Lock lock( _mutex );	
-	for( unsigned int i = 0; i < _numWorkers; i++) 
+	Lock lock( _mutex );
+	if( !_workerThreads.empty() ) { return; }
+
+	// Allocate queues up front so they never change while workers run
+	ResizeQueues( _autoscale ? _maxWorkers : _numWorkers );
+	unsigned int numStart = _autoscale ? _minWorkers : _queues.size();
+	_scaling.store( _autoscale && _maxWorkers > _minWorkers );
+	_lastGrowth.store( 0 );
+	_numActive.store( numStart );
+	_workerThreads.resize( _queues.size() );
+	for( unsigned int i = 0; i < numStart; i++ )
 	{
-		_workerThreads.create_thread( boost::bind( &WorkerPool::WorkerLoop, 
-		                                           this ) );
+		_workerThreads[i] = std::make_shared<boost::thread>(
+		    boost::bind( &WorkerPool::WorkerLoop, this, i ) );
 	}
 }
 
 void WorkerPool::StopWorkers()
 {
-	// TODO Acquire lock?
-	_workerThreads.interrupt_all();
-	_workerThreads.join_all();
+	Lock lock( _mutex );
+	_scaling.store( false );
+	for( unsigned int i = 0; i < _workerThreads.size(); i++ )
+	{
+		if( _workerThreads[i] ) { _workerThreads[i]->interrupt(); }
+	}
+	for( unsigned int i = 0; i < _workerThreads.size(); i++ )
+	{
+		if( _workerThreads[i] ) { _workerThreads[i]->join(); }
+	}
+	_workerThreads.clear();
+	_numActive.store( 0 );
 }
 
 void WorkerPool::WaitOnJobs()
 {
-	Lock lock( _mutex );
-	while( !_jobQueue.empty() || _activeThreads > 0 )
+	QueueLock lock( _sleepMutex );
+	while( _numOutstanding.load() > 0 )
+	{
+		_jobsDone.wait( lock );
+	}
+}
+
+unsigned int WorkerPool::NumPending() const
+{
+	return _numPending.load();
+}
+
+void WorkerPool::SetStatisticsEnabled( bool enable )
+{
+	_statsEnabled.store( enable );
+}
+
+WorkerPoolStatistics WorkerPool::GetStatistics() const
+{
+	QueueLock lock( _statsMutex );
+	Clock::time_point now = Clock::now();
+
+	WorkerPoolStatistics stats;
+	stats.elapsed = ToSeconds( now - _statsStart );
+	stats.numWorkers = _numActive.load();
+	stats.queueDepth = _numPending.load();
+	stats.peakQueueDepth = _peakPending.load();
+
+	unsigned long queueTime = 0;
+	unsigned long runTime = 0;
+	for( unsigned int i = 0; i < _queues.size(); i++ )
+	{
+		const WorkerStats& ws = _queues[i]->stats;
+		unsigned long busy = ws.runTime.load();
+		stats.numCompleted += ws.numJobs.load();
+		queueTime += ws.queueTime.load();
+		runTime += busy;
+		for( unsigned int j = 0; j < WorkerPoolStatistics::NumBuckets; j++ )
+		{
+			stats.queueTimeHistogram[j] += ws.queueHistogram[j].load();
+			stats.runTimeHistogram[j] += ws.runHistogram[j].load();
+		}
+		// Retired workers' jobs still count, but only active workers are listed
+		if( i < stats.numWorkers )
+		{
+			stats.workerUtilization.push_back( stats.elapsed > 0 ?
+			                                   busy * 1E-9 / stats.elapsed : 0 );
+		}
+	}
+	if( stats.numCompleted > 0 )
+	{
+		stats.meanQueueTime = queueTime * 1E-9 / stats.numCompleted;
+		stats.meanRunTime = runTime * 1E-9 / stats.numCompleted;
+	}
+	return stats;
+}
+
+void WorkerPool::ResetStatistics()
+{
+	QueueLock lock( _statsMutex );
+	_statsStart = Clock::now();
+	_peakPending.store( _numPending.load() );
+	for( unsigned int i = 0; i < _queues.size(); i++ )
+	{
+		_queues[i]->stats.Reset();
+	}
+}
+
+void WorkerPool::ResizeQueues( unsigned int n )
+{
+	if( n == 0 ) { n = 1; }
+	if( n == _queues.size() ) { return; }
+
+	// Carry over jobs enqueued before the workers were started
+	std::deque<QueuedJob> pending;
+	for( unsigned int i = 0; i < _queues.size(); i++ )
+	{
+		QueueLock lock( _queues[i]->mutex );
+		pending.insert( pending.end(), _queues[i]->jobs.begin(), _queues[i]->jobs.end() );
+	}
+
+	std::vector< std::shared_ptr<WorkerQueue> > queues;
+	for( unsigned int i = 0; i < n; i++ )
+	{
+		queues.push_back( std::make_shared<WorkerQueue>() );
+	}
+	for( unsigned int i = 0; i < pending.size(); i++ )
 	{
-		_threadsDone.wait( lock );
+		queues[i % n]->jobs.push_back( pending[i] );
 	}
+
+	// Statistics readers hold only the stats lock, so that they never wait
+	// on StopWorkers joining the workers
+	QueueLock lock( _statsMutex );
+	_queues.swap( queues );
+}
+
+void WorkerPool::AddPending()
+{
+	unsigned int depth = ++_numPending;
+	unsigned int peak = _peakPending.load( std::memory_order_relaxed );
+	while( depth > peak &&
+	       !_peakPending.compare_exchange_weak( peak, depth, std::memory_order_relaxed ) ) {}
 }
 
-void WorkerPool::WorkerLoop()
+void WorkerPool::NotifyWorkers()
 {
+	// Pairs with the check in WorkerLoop so a worker cannot sleep through this job
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	if( _numSleeping.load() > 0 )
+	{
+		QueueLock lock( _sleepMutex );
+		_hasJobs.notify_one();
+	}
+}
+
+void WorkerPool::PinWorker( unsigned int index )
+{
+	if( _cpuAffinity.empty() ) { return; }
+
+	unsigned int core = _cpuAffinity[index % _cpuAffinity.size()];
+	cpu_set_t set;
+	CPU_ZERO( &set );
+	CPU_SET( core, &set );
+	int ret = pthread_setaffinity_np( pthread_self(), sizeof( set ), &set );
+	if( ret != 0 )
+	{
+		ROS_WARN_STREAM( "WorkerPool: Could not pin worker " << index << " to core "
+		                 << core << ": " << std::strerror( ret ) );
+	}
+}
+
+bool WorkerPool::PopLaneJob( bool onlyUrgent, QueuedJob& item )
+{
+	if( _numLaneJobs.load() == 0 ) { return false; }
+
+	QueueLock lock( _laneMutex );
+	if( _laneJobs.empty() ) { return false; }
+	if( onlyUrgent &&
+	    _laneJobs.front().deadline > Clock::now() + _laneLatencies[PRIORITY_NORMAL] )
+	{
+		return false;
+	}
+
+	std::pop_heap( _laneJobs.begin(), _laneJobs.end() );
+	item.job.swap( _laneJobs.back().item.job );
+	item.enqueued = _laneJobs.back().item.enqueued;
+	_laneJobs.pop_back();
+	--_numLaneJobs;
+	--_numPending;
+	return true;
+}
+
+bool WorkerPool::PopJob( unsigned int index, QueuedJob& item )
+{
+	// Lane jobs at least as urgent as normal work go first
+	if( PopLaneJob( true, item ) ) { return true; }
+
+	// Own queue next, oldest job first
+	{
+		WorkerQueue& own = *_queues[index];
+		QueueLock lock( own.mutex );
+		if( !own.jobs.empty() )
+		{
+			item.job.swap( own.jobs.front().job );
+			item.enqueued = own.jobs.front().enqueued;
+			own.jobs.pop_front();
+			--_numPending;
+			return true;
+		}
+	}
+
+	// Then steal the newest job from the others
+	for( unsigned int i = 1; i < _queues.size(); i++ )
+	{
+		WorkerQueue& victim = *_queues[( index + i ) % _queues.size()];
+		QueueLock lock( victim.mutex, boost::try_to_lock );
+		if( !lock.owns_lock() || victim.jobs.empty() ) { continue; }
+		item.job.swap( victim.jobs.back().job );
+		item.enqueued = victim.jobs.back().enqueued;
+		victim.jobs.pop_back();
+		--_numPending;
+		return true;
+	}
+
+	// Idle, so run lane jobs ahead of their deadlines
+	return PopLaneJob( false, item );
+}
+
+void WorkerPool::RunJob( unsigned int index, QueuedJob& item )
+{
+	if( item.enqueued == Clock::time_point() )
+	{
+		item.job();
+		return;
+	}
+
+	Clock::time_point start = Clock::now();
+	if( _scaling.load( std::memory_order_relaxed ) &&
+	    start - item.enqueued > _targetQueueTime )
+	{
+		MaybeGrow();
+	}
+	if( !_statsEnabled.load( std::memory_order_relaxed ) )
+	{
+		item.job();
+		return;
+	}
+
+	item.job();
+	Clock::time_point finish = Clock::now();
+	_queues[index]->stats.Record( start - item.enqueued, finish - start );
+}
+
+void WorkerPool::FinishJob()
+{
+	if( --_numOutstanding == 0 )
+	{
+		QueueLock lock( _sleepMutex );
+		_jobsDone.notify_all();
+	}
+}
+
+void WorkerPool::MaybeGrow()
+{
+	// Allow one new worker per target queue time, so each has a chance to
+	// bring the queue time down before the next is added
+	long now = NowNanoseconds();
+	long last = _lastGrowth.load();
+	if( now - last < (long) ToNanoseconds( _targetQueueTime ) ) { return; }
+	if( !_lastGrowth.compare_exchange_strong( last, now ) ) { return; }
+
+	// Never block here, since StopWorkers holds the lock while joining workers
+	Lock lock( _mutex, boost::try_to_lock );
+	if( !lock.owns_lock() || !_scaling.load() ) { return; }
+
+	// Racing with TryRetire on the count keeps active queues contiguous
+	unsigned int active = _numActive.load();
+	if( active >= _maxWorkers ) { return; }
+	if( !_numActive.compare_exchange_strong( active, active + 1 ) ) { return; }
+
+	// A worker that retired from this queue has already left its loop
+	if( _workerThreads[active] ) { _workerThreads[active]->join(); }
+	_workerThreads[active] = std::make_shared<boost::thread>(
+	    boost::bind( &WorkerPool::WorkerLoop, this, active ) );
+}
+
+bool WorkerPool::TryRetire( unsigned int index )
+{
+	// Only the last active worker retires, so that active queues stay contiguous
+	unsigned int active = index + 1;
+	if( active <= _minWorkers || _numPending.load() > 0 ) { return false; }
+	return _numActive.compare_exchange_strong( active, index );
+}
+
+void WorkerPool::WorkerLoop( unsigned int index )
+{
+	tlsPool = this;
+	tlsIndex = index;
+
+	// Pin before allocating so that scratch pages land on the local node
+	PinWorker( index );
+	ScratchBuffer scratch( _scratchSize );
+	tlsScratch = scratch.data;
+	tlsScratchSize = scratch.size;
+
+	bool sleeping = false;
 	try {
-		while( true ) 
+		QueuedJob item;
+		while( true )
 		{
 			boost::this_thread::interruption_point();
 
-			// Reacquire lock to allow other threads a chance
-			Lock lock( _mutex );
-			
-			// Wait on a job here
-			while( _jobQueue.empty() )
+			if( PopJob( index, item ) )
 			{
-				_hasJobs.wait( lock );
+				RunJob( index, item );
+				item.job.clear();
+				FinishJob();
+				continue;
 			}
-			
-			_activeThreads++;
-			Job job = _jobQueue.front();
-			_jobQueue.pop();
-			lock.unlock();
-			
-			job();
-			
-			lock.lock();
-			_activeThreads--;
-			if( _activeThreads == 0 )
+
+			// Sleep only if there is really nothing left to steal
+			QueueLock lock( _sleepMutex );
+			++_numSleeping;
+			sleeping = true;
+			std::atomic_thread_fence( std::memory_order_seq_cst );
+			bool retire = false;
+			if( _numPending.load() == 0 )
 			{
-				_threadsDone.notify_all();
+				if( !_scaling.load() ) { _hasJobs.wait( lock ); }
+				else if( _hasJobs.wait_for( lock, _idleTimeout ) == boost::cv_status::timeout )
+				{
+					retire = TryRetire( index );
+				}
 			}
+			--_numSleeping;
+			sleeping = false;
+			if( retire ) { return; }
 		}
 	}
-	catch( boost::thread_interrupted e ) { return; }
+	catch( boost::thread_interrupted e )
+	{
+		if( sleeping ) { --_numSleeping; }
+	}
 }
 
 }
@@ -0,0 +1,66 @@
+#include "argus_utils/synchronization/WorkerPoolMonitor.h"
+#include "argus_utils/utils/ParamUtils.h"
+
+namespace argus
+{
+
+argus_msgs::WorkerPoolStatistics StatisticsToMsg( const WorkerPoolStatistics& stats )
+{
+	argus_msgs::WorkerPoolStatistics msg;
+	msg.elapsed = stats.elapsed;
+	msg.num_workers = stats.numWorkers;
+	msg.queue_depth = stats.queueDepth;
+	msg.peak_queue_depth = stats.peakQueueDepth;
+	msg.num_completed = stats.numCompleted;
+	msg.mean_queue_time = stats.meanQueueTime;
+	msg.mean_run_time = stats.meanRunTime;
+	for( unsigned int i = 0; i < WorkerPoolStatistics::NumBuckets; i++ )
+	{
+		msg.bucket_upper_bounds.push_back( WorkerPoolStatistics::BucketUpperBound( i ) );
+	}
+	msg.queue_time_histogram.assign( stats.queueTimeHistogram.begin(),
+	                                 stats.queueTimeHistogram.end() );
+	msg.run_time_histogram.assign( stats.runTimeHistogram.begin(),
+	                               stats.runTimeHistogram.end() );
+	msg.worker_utilization = stats.workerUtilization;
+	return msg;
+}
+
+WorkerPoolMonitor::WorkerPoolMonitor( WorkerPool& pool )
+: _pool( pool ), _resetOnPublish( false ) {}
+
+void WorkerPoolMonitor::Initialize( ros::NodeHandle& nh,
+                                    const std::string& topic,
+                                    double rate,
+                                    bool resetOnPublish )
+{
+	if( rate <= 0 )
+	{
+		throw std::invalid_argument( "WorkerPoolMonitor: Rate must be positive." );
+	}
+	_resetOnPublish = resetOnPublish;
+	_statsPub = nh.advertise<argus_msgs::WorkerPoolStatistics>( topic, 10 );
+	_publishTimer = nh.createTimer( ros::Duration( 1.0/rate ),
+	                                &WorkerPoolMonitor::TimerCallback,
+	                                this );
+}
+
+void WorkerPoolMonitor::Initialize( ros::NodeHandle& nh,
+                                    ros::NodeHandle& ph,
+                                    const std::string& topic,
+                                    bool resetOnPublish )
+{
+	double rate;
+	GetParam( ph, "publish_rate", rate, 1.0 );
+	Initialize( nh, topic, rate, resetOnPublish );
+}
+
+void WorkerPoolMonitor::TimerCallback( const ros::TimerEvent& event )
+{
+	argus_msgs::WorkerPoolStatistics msg = StatisticsToMsg( _pool.GetStatistics() );
+	if( _resetOnPublish ) { _pool.ResetStatistics(); }
+	msg.header.stamp = event.current_real;
+	_statsPub.publish( msg );
+}
+
+}
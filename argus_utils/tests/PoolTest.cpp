@@ -0,0 +1,312 @@
+#include "argus_utils/synchronization/InplaceFunction.hpp"
+#include "argus_utils/synchronization/ParallelFor.hpp"
+#include "argus_utils/synchronization/TimerWheel.h"
+#include "argus_utils/synchronization/WorkerPool.h"
+
+#include <boost/thread/thread.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+using namespace argus;
+
+// Counts every global allocation in this process, for the allocation test
+std::atomic<unsigned long> numNews( 0 );
+
+void* operator new( size_t bytes )
+{
+	++numNews;
+	void* ptr = std::malloc( bytes > 0 ? bytes : 1 );
+	if( !ptr ) { throw std::bad_alloc(); }
+	return ptr;
+}
+
+void operator delete( void* ptr ) noexcept
+{
+	std::free( ptr );
+}
+
+struct Doubler
+{
+	std::vector<long>* values;
+
+	void operator()( size_t i ) const { ( *values )[i] = 2 * i; }
+};
+
+struct Thrower
+{
+	void operator()( size_t i ) const
+	{
+		if( i == 500 ) { throw std::runtime_error( "Thrower" ); }
+	}
+};
+
+long Identity( size_t i ) { return i; }
+long Add( long a, long b ) { return a + b; }
+std::string Digit( size_t i ) { return std::string( 1, '0' + i % 10 ); }
+std::string Concatenate( const std::string& a, const std::string& b ) { return a + b; }
+
+void ParallelForTest()
+{
+	WorkerPool pool( 4 );
+	pool.StartWorkers();
+
+	const size_t num = 100000;
+	std::vector<long> values( num, -1 );
+	Doubler doubler = { &values };
+	ParallelFor( pool, 0, num, 0, doubler );
+	bool passed = true;
+	for( size_t i = 0; i < num && passed; ++i )
+	{
+		passed = values[i] == 2 * (long) i;
+	}
+
+	// Chunk results are combined in index order, so a non-commutative
+	// reduction matches the serial one
+	std::string serial;
+	for( size_t i = 0; i < 200; ++i ) { serial += Digit( i ); }
+	passed = passed && ParallelReduce( pool, 0, num, 7, 0L, &Identity, &Add ) ==
+	                   (long) num * ( num - 1 ) / 2;
+	passed = passed && ParallelReduce( pool, 0, 200, 3, std::string(), &Digit, &Concatenate ) == serial;
+	passed = passed && ParallelReduce( pool, 5, 5, 0, 3L, &Identity, &Add ) == 3;
+
+	try
+	{
+		ParallelFor( pool, 0, 1000, 10, Thrower() );
+		passed = false;
+	}
+	catch( std::runtime_error& e ) {}
+
+	std::cout << ( passed ? "Passed" : "Failed" ) << " parallel for test." << std::endl;
+}
+
+struct Gate
+{
+	boost::mutex mutex;
+	boost::condition_variable opened;
+	bool open;
+
+	Gate() : open( false ) {}
+
+	void Wait()
+	{
+		boost::unique_lock<boost::mutex> lock( mutex );
+		while( !open ) { opened.wait( lock ); }
+	}
+
+	void Open()
+	{
+		boost::unique_lock<boost::mutex> lock( mutex );
+		open = true;
+		opened.notify_all();
+	}
+};
+
+void ParallelIndependenceTest()
+{
+	// With every worker blocked on other jobs, a call still completes on the
+	// calling thread, without waiting on the jobs
+	WorkerPool pool( 2 );
+	pool.StartWorkers();
+	Gate gate;
+	for( int i = 0; i < 4; ++i )
+	{
+		pool.EnqueueJob( boost::bind( &Gate::Wait, &gate ) );
+	}
+
+	std::vector<long> values( 1000, -1 );
+	Doubler doubler = { &values };
+	ParallelFor( pool, 0, values.size(), 10, doubler );
+	bool passed = values.back() == 2 * (long) ( values.size() - 1 ) &&
+	              ParallelReduce( pool, 0, 100, 10, 0L, &Identity, &Add ) == 4950;
+
+	gate.Open();
+	pool.WaitOnJobs();
+	std::cout << ( passed ? "Passed" : "Failed" ) << " parallel independence test." << std::endl;
+}
+
+struct Counter
+{
+	std::atomic<unsigned long>* count;
+	char padding[32];
+
+	void operator()() const { ++( *count ); }
+};
+
+void RunJobs( WorkerPool& pool, unsigned long numJobs, std::atomic<unsigned long>& count )
+{
+	Counter counter;
+	counter.count = &count;
+	for( unsigned long i = 0; i < numJobs; ++i )
+	{
+		pool.EnqueueJob( counter );
+	}
+	pool.WaitOnJobs();
+}
+
+void AllocationTest()
+{
+	// Once the job queues and pools have grown, submitting jobs that fit the
+	// inline buffer should not reach operator new
+	const unsigned long numJobs = 100000;
+	WorkerPool pool( 4 );
+	pool.StartWorkers();
+	std::atomic<unsigned long> count( 0 );
+	RunJobs( pool, numJobs, count );
+
+	unsigned long before = numNews.load();
+	RunJobs( pool, numJobs, count );
+	unsigned long allocated = numNews.load() - before;
+
+	bool passed = count.load() == 2 * numJobs && allocated < 100;
+	std::cout << ( passed ? "Passed" : "Failed" ) << " allocation test with "
+	          << allocated << " allocations for " << numJobs << " jobs." << std::endl;
+}
+
+void ReadStatistics( WorkerPool& pool, std::atomic<bool>& running )
+{
+	while( running.load() )
+	{
+		pool.GetStatistics();
+		pool.ResetStatistics();
+	}
+}
+
+void StatisticsTest()
+{
+	// Restarting with a different size rebuilds the queues under a reader
+	WorkerPool pool( 1 );
+	std::atomic<bool> running( true );
+	boost::thread reader( boost::bind( &ReadStatistics, boost::ref( pool ), boost::ref( running ) ) );
+	for( unsigned int i = 0; i < 50; ++i )
+	{
+		pool.SetNumWorkers( 1 + i % 4 );
+		pool.StartWorkers();
+		pool.StopWorkers();
+	}
+	running.store( false );
+	reader.join();
+
+	// Only active workers are listed
+	pool.SetAutoscaling( 1, 4, 0.005, 5.0 );
+	pool.StartWorkers();
+	bool passed = pool.GetStatistics().workerUtilization.size() == pool.GetNumActiveWorkers();
+	pool.StopWorkers();
+	passed = passed && pool.GetStatistics().workerUtilization.empty();
+	std::cout << ( passed ? "Passed" : "Failed" ) << " statistics test." << std::endl;
+}
+
+/*! \brief A callable aligned like a vectorized Eigen type, which records
+ * whether it was invoked at an aligned address. */
+template <size_t Size>
+struct alignas( 32 ) AlignedCallable
+{
+	bool* aligned;
+	char padding[Size];
+
+	void operator()() const
+	{
+		*aligned = reinterpret_cast<uintptr_t>( this ) % 32 == 0;
+	}
+};
+
+template <typename Callable>
+bool RunsAligned()
+{
+	// Fill some blocks first, so the callable does not land at the chunk start
+	bool aligned = false;
+	std::vector< InplaceFunction<void()> > functions;
+	for( unsigned int i = 0; i < 5; ++i )
+	{
+		Callable callable = { &aligned };
+		functions.push_back( callable );
+	}
+	bool passed = true;
+	for( unsigned int i = 0; i < functions.size(); ++i )
+	{
+		aligned = false;
+		InplaceFunction<void()> copy( functions[i] );
+		copy();
+		passed = passed && aligned;
+	}
+	return passed;
+}
+
+void AlignmentTest()
+{
+	// Callables that do not fit inline go to pooled or large memory
+	typedef InplaceFunction<void()> Function;
+	bool passed = !Function::IsInline< AlignedCallable<100> >() &&
+	              RunsAligned< AlignedCallable<8> >() &&
+	              RunsAligned< AlignedCallable<100> >() &&
+	              RunsAligned< AlignedCallable<2000> >();
+	std::cout << ( passed ? "Passed" : "Failed" ) << " alignment test." << std::endl;
+}
+
+/*! \brief Exposes the tick the driver sleeps until. */
+class WatchedTimerWheel : public TimerWheel
+{
+public:
+
+	WatchedTimerWheel( WorkerPool& pool, double resolution )
+	: TimerWheel( pool, resolution ) {}
+
+	bool IsSleepingForever() const
+	{
+		Lock lock( _mutex );
+		return _wakeTick == std::numeric_limits<unsigned long>::max();
+	}
+
+	bool IsSleepingUntil( double delay ) const
+	{
+		Lock lock( _mutex );
+		return _wakeTick > _currentTick &&
+		       _wakeTick <= _currentTick + (unsigned long) ( delay / 1E-4 );
+	}
+};
+
+void TimerTest()
+{
+	WorkerPool pool( 2 );
+	pool.StartWorkers();
+	WatchedTimerWheel wheel( pool, 1E-4 );
+	wheel.Start();
+
+	// Idle for many level 0 wraps, then a timer still fires on time
+	boost::this_thread::sleep_for( boost::chrono::milliseconds( 100 ) );
+	bool passed = wheel.IsSleepingForever();
+	std::atomic<unsigned long> count( 0 );
+	Counter counter;
+	counter.count = &count;
+	wheel.AddOneShot( counter, 0.01 );
+	boost::this_thread::sleep_for( boost::chrono::milliseconds( 50 ) );
+	passed = passed && count.load() == 1 && wheel.IsSleepingForever();
+
+	// A distant timer sleeps until its slot cascades, not every wrap
+	TimerWheel::TimerId id = wheel.AddOneShot( counter, 60 );
+	boost::this_thread::sleep_for( boost::chrono::milliseconds( 50 ) );
+	passed = passed && !wheel.IsSleepingUntil( 1.0 ) && wheel.IsSleepingUntil( 60 );
+	wheel.Cancel( id );
+
+	wheel.AddPeriodic( counter, 0.005 );
+	boost::this_thread::sleep_for( boost::chrono::milliseconds( 100 ) );
+	unsigned long fired = count.load() - 1;
+	passed = passed && fired >= 10 && fired <= 21;
+	wheel.Stop();
+	std::cout << ( passed ? "Passed" : "Failed" ) << " timer test." << std::endl;
+}
+
+int main( int argc, char** argv )
+{
+	ParallelForTest();
+	ParallelIndependenceTest();
+	AllocationTest();
+	AlignmentTest();
+	StatisticsTest();
+	TimerTest();
+	return 0;
+}
@@ -0,0 +1,471 @@
+#include "argus_utils/synchronization/RingQueue.hpp"
+#include "argus_utils/synchronization/ThreadsafeQueue.hpp"
+#include "argus_utils/synchronization/SpscQueue.hpp"
+#include "argus_utils/synchronization/Pipeline.hpp"
+#include "argus_utils/synchronization/QueueSelector.hpp"
+#include "argus_utils/synchronization/Semaphore.h"
+
+#include <boost/chrono/process_cpu_clocks.hpp>
+#include <boost/thread/thread.hpp>
+#include <iostream>
+
+using namespace argus;
+
+void RingOverflowTest()
+{
+	RingQueue<int> queue( 3 );
+	for( int i = 0; i < 5; ++i )
+	{
+		queue.PushBack( i );
+	}
+
+	int item;
+	bool passed = queue.Size() == 3;
+	for( int i = 2; i < 5; ++i )
+	{
+		passed = passed && queue.TryPopFront( item ) && item == i;
+	}
+	passed = passed && !queue.TryPopFront( item );
+
+	// A single slot cannot tell full from empty, so it is rounded up to two
+	RingQueue<int> single( 1 );
+	passed = passed && single.Capacity() == 2;
+	for( int i = 0; i < 10; ++i )
+	{
+		single.PushBack( i );
+		passed = passed && single.TryPopFront( item ) && item == i;
+	}
+	for( int i = 0; i < 5; ++i )
+	{
+		single.PushBack( i );
+	}
+	passed = passed && single.TryPopFront( item ) && item == 3 &&
+	         single.TryPopFront( item ) && item == 4 && !single.TryPopFront( item );
+	std::cout << ( passed ? "Passed" : "Failed" ) << " ring overflow test." << std::endl;
+}
+
+void RingProducer( RingQueue<int>& queue, int num )
+{
+	for( int i = 1; i <= num; ++i )
+	{
+		queue.PushBack( i );
+	}
+}
+
+void RingConsumer( RingQueue<int>& queue, long& sum )
+{
+	int item;
+	while( queue.WaitPopFront( item ) && item != 0 )
+	{
+		sum += item;
+	}
+}
+
+void RingThreadTest()
+{
+	const int numThreads = 4;
+	const int numItems = 100000;
+	RingQueue<int> queue( 4 * numItems );
+
+	boost::thread_group producers, consumers;
+	std::vector<long> sums( numThreads, 0 );
+	for( int i = 0; i < numThreads; ++i )
+	{
+		consumers.create_thread( boost::bind( &RingConsumer, boost::ref( queue ),
+		                                      boost::ref( sums[i] ) ) );
+		producers.create_thread( boost::bind( &RingProducer, boost::ref( queue ),
+		                                      numItems ) );
+	}
+	producers.join_all();
+	for( int i = 0; i < numThreads; ++i )
+	{
+		queue.PushBack( 0 );
+	}
+	consumers.join_all();
+
+	long total = 0;
+	for( int i = 0; i < numThreads; ++i ) { total += sums[i]; }
+	long expected = numThreads * ( (long) numItems * ( numItems + 1 ) / 2 );
+	std::cout << ( total == expected ? "Passed" : "Failed" ) << " ring thread test." << std::endl;
+}
+
+void BatchTest()
+{
+	// Move-only items check that nothing is copied
+	ThreadsafeQueue< std::unique_ptr<int> > queue( 4 );
+	std::vector< std::unique_ptr<int> > in;
+	for( int i = 0; i < 6; ++i )
+	{
+		in.emplace_back( new int( i ) );
+	}
+	queue.PushRange( std::make_move_iterator( in.begin() ),
+	                 std::make_move_iterator( in.end() ) );
+
+	std::vector< std::unique_ptr<int> > out;
+	bool passed = queue.PopUpTo( 3, out ) == 3 && queue.Size() == 1;
+	passed = passed && queue.PopAll( out ) == 1 && queue.IsEmpty();
+	for( int i = 0; i < 4 && passed; ++i )
+	{
+		passed = *out[i] == i + 2;
+	}
+	std::cout << ( passed ? "Passed" : "Failed" ) << " batch test." << std::endl;
+}
+
+void PolicyTest()
+{
+	ThreadsafeQueue<int> queue( 2, OVERFLOW_DROP_NEWEST );
+	queue.PushBack( 0 );
+	queue.PushBack( 1 );
+	bool passed = !queue.PushBack( 2 );
+
+	queue.SetOverflowPolicy( OVERFLOW_REJECT );
+	try
+	{
+		queue.PushBack( 3 );
+		passed = false;
+	}
+	catch( std::overflow_error& e ) {}
+
+	queue.SetOverflowPolicy( OVERFLOW_BLOCK );
+	passed = passed && !queue.WaitPushFor( 4, 0.01 );
+
+	int item;
+	passed = passed && queue.WaitPopFor( item, 0.01 ) && item == 0;
+	passed = passed && queue.WaitPopFor( item, 0.01 ) && item == 1;
+	passed = passed && !queue.WaitPopFor( item, 0.01 );
+
+	QueueStatistics stats = queue.GetStatistics();
+	passed = passed && stats.numPushed == 2 && stats.numPopped == 2 &&
+	         stats.numDropped == 1 && stats.numRejected == 1 &&
+	         stats.highWaterMark == 2 && stats.pushBlockedTime > 0;
+	std::cout << ( passed ? "Passed" : "Failed" ) << " policy test." << std::endl;
+}
+
+template <template<typename,typename> class Container>
+void QueueProducer( ThreadsafeQueue<int, Container>& queue, int num )
+{
+	for( int i = 1; i <= num; ++i )
+	{
+		queue.PushBack( i );
+	}
+	queue.PushBack( 0 );
+}
+
+// Same code runs on the locked and single-producer/single-consumer queues
+template <template<typename,typename> class Container>
+void SingleProducerTest( const std::string& name )
+{
+	const int numItems = 100000;
+	ThreadsafeQueue<int, Container> queue( 64, OVERFLOW_BLOCK );
+	boost::thread producer( boost::bind( &QueueProducer<Container>,
+	                                     boost::ref( queue ), numItems ) );
+
+	long sum = 0;
+	int item;
+	while( queue.WaitPopFront( item ) && item != 0 )
+	{
+		sum += item;
+	}
+	producer.join();
+
+	bool passed = sum == (long) numItems * ( numItems + 1 ) / 2;
+	std::cout << ( passed ? "Passed" : "Failed" ) << " " << name
+	          << " single producer test." << std::endl;
+}
+
+void SpscDropProducer( SpscQueue<int>& queue, int num )
+{
+	for( int i = 1; i <= num; ++i )
+	{
+		queue.PushBack( i );
+	}
+	queue.WaitPushFor( 0, 10.0 );
+}
+
+void SpscOverflowTest()
+{
+	// Drops the oldest by default, like the locked queue
+	SpscQueue<int> queue( 3 );
+	for( int i = 0; i < 5; ++i )
+	{
+		queue.PushBack( i );
+	}
+	int item;
+	bool passed = queue.Size() == 3;
+	for( int i = 2; i < 5; ++i )
+	{
+		passed = passed && queue.TryPopFront( item ) && item == i;
+	}
+	passed = passed && !queue.TryPopFront( item );
+
+	// Alternating pushes and pops never hold more than one item
+	SpscQueue<int> alternating( 8 );
+	for( int i = 0; i < 20; ++i )
+	{
+		alternating.PushBack( i );
+		passed = passed && alternating.TryPopFront( item ) && item == i;
+	}
+	passed = passed && alternating.GetStatistics().highWaterMark == 1;
+
+	// The producer drops while the consumer pops, so items still arrive in
+	// order and each is either popped or dropped
+	const int numItems = 100000;
+	SpscQueue<int> small( 4 );
+	boost::thread producer( boost::bind( &SpscDropProducer, boost::ref( small ), numItems ) );
+	int last = 0;
+	while( small.WaitPopFront( item ) && item != 0 )
+	{
+		passed = passed && item > last;
+		last = item;
+	}
+	producer.join();
+
+	QueueStatistics stats = small.GetStatistics();
+	passed = passed && stats.numPushed == numItems + 1 &&
+	         stats.numPopped + stats.numDropped == numItems + 1;
+	std::cout << ( passed ? "Passed" : "Failed" ) << " spsc overflow test." << std::endl;
+}
+
+bool SquareEven( int& in, long& out )
+{
+	out = (long) in * in;
+	return in % 2 == 0;
+}
+
+bool Halve( long& in, long& out )
+{
+	out = in / 2;
+	return true;
+}
+
+void Accumulate( long& in, long& sum )
+{
+	sum += in;
+}
+
+void PipelineTest()
+{
+	// Small queues force the stages to block on each other
+	Pipeline pipeline;
+	Stage<int, long>::Ptr square = pipeline.AddStage<int, long>( "square", &SquareEven, 2, 2 );
+	Stage<long, long>::Ptr halve = pipeline.AddStage<long, long>( "halve", &Halve, 3, 2 );
+	long sum = 0;
+	square->ConnectTo( halve );
+	halve->SetSink( boost::bind( &Accumulate, _1, boost::ref( sum ) ) );
+
+	// The sink is only called from halve's threads
+	halve->SetNumThreads( 1 );
+	pipeline.Start();
+	long expected = 0;
+	for( int i = 0; i < 1000; ++i )
+	{
+		square->Push( i );
+		if( i % 2 == 0 ) { expected += (long) i * i / 2; }
+	}
+	pipeline.WaitIdle();
+
+	std::vector<StageStatistics> stats = pipeline.GetStatistics();
+	bool passed = sum == expected && stats.size() == 2 &&
+	              stats[0].numProcessed == 500 && stats[0].numFiltered == 500 &&
+	              stats[1].numProcessed == 500 && stats[1].queue.highWaterMark <= 2;
+	pipeline.Stop();
+	std::cout << ( passed ? "Passed" : "Failed" ) << " pipeline test." << std::endl;
+}
+
+void SelectorProducer( ThreadsafeQueue<int>& queue, int num )
+{
+	for( int i = 1; i <= num; ++i )
+	{
+		queue.PushBack( i );
+	}
+}
+
+void SelectorTest()
+{
+	const int numQueues = 8;
+	const int numItems = 10000;
+	std::vector< std::shared_ptr< ThreadsafeQueue<int> > > queues;
+	QueueSelector selector;
+	for( int i = 0; i < numQueues; ++i )
+	{
+		queues.push_back( std::make_shared< ThreadsafeQueue<int> >() );
+		selector.Add( *queues.back() );
+	}
+
+	unsigned int index;
+	bool passed = !selector.WaitFor( index, 0.01 );
+
+	boost::thread_group producers;
+	for( int i = 0; i < numQueues; ++i )
+	{
+		producers.create_thread( boost::bind( &SelectorProducer,
+		                                      boost::ref( *queues[i] ), numItems ) );
+	}
+
+	// One thread consumes every queue
+	long sum = 0;
+	int item;
+	int numReceived = 0;
+	while( numReceived < numQueues * numItems && selector.WaitFor( index, 1.0 ) )
+	{
+		while( queues[index]->TryPopFront( item ) )
+		{
+			sum += item;
+			++numReceived;
+		}
+	}
+	producers.join_all();
+
+	// Removing a queue keeps the other indices, and it is no longer reported
+	passed = passed && selector.Remove( 2 ) && !selector.Remove( 2 ) &&
+	         selector.Size() == numQueues - 1;
+	queues[2]->PushBack( 1 );
+	queues[5]->PushBack( 1 );
+	passed = passed && selector.WaitFor( index, 0.1 ) && index == 5 &&
+	         queues[5]->TryPopFront( item ) && !selector.WaitFor( index, 0.01 );
+	selector.Clear();
+	passed = passed && selector.Size() == 0;
+
+	passed = passed && sum == numQueues * ( (long) numItems * ( numItems + 1 ) / 2 );
+	std::cout << ( passed ? "Passed" : "Failed" ) << " selector test." << std::endl;
+}
+
+/*! \brief A queue that always has items, and whose check blocks until
+ * released, to hold a selector mid-check. */
+struct GatedQueue
+{
+	boost::mutex mutex;
+	boost::condition_variable changed;
+	bool checking;
+	bool released;
+
+	GatedQueue() : checking( false ), released( false ) {}
+
+	bool IsEmpty()
+	{
+		boost::unique_lock<boost::mutex> lock( mutex );
+		checking = true;
+		changed.notify_all();
+		while( !released ) { changed.wait( lock ); }
+		return false;
+	}
+
+	void WaitChecking()
+	{
+		boost::unique_lock<boost::mutex> lock( mutex );
+		while( !checking ) { changed.wait( lock ); }
+	}
+
+	void Release()
+	{
+		boost::unique_lock<boost::mutex> lock( mutex );
+		released = true;
+		changed.notify_all();
+	}
+
+	void AddListener( QueueListener* listener, unsigned int tag ) {}
+	void RemoveListener( QueueListener* listener ) {}
+};
+
+void SelectorWaiter( QueueSelector& selector, bool& found )
+{
+	unsigned int index;
+	found = selector.WaitFor( index, 0.2 );
+}
+
+void SelectorStaleTest()
+{
+	// An index checked while the selector is cleared and refilled refers to
+	// a different queue afterwards, so the result must not be reported
+	QueueSelector selector;
+	GatedQueue gated;
+	ThreadsafeQueue<int> empty;
+	selector.Add( gated );
+	bool found = true;
+	boost::thread waiter( boost::bind( &SelectorWaiter, boost::ref( selector ), boost::ref( found ) ) );
+	gated.WaitChecking();
+	selector.Clear();
+	bool passed = selector.Add( empty ) == 0;
+	gated.Release();
+	waiter.join();
+	selector.Clear();
+
+	passed = passed && !found;
+	std::cout << ( passed ? "Passed" : "Failed" ) << " selector stale test." << std::endl;
+}
+
+void SemaphoreWaiter( Semaphore& sem, int num, bool& success )
+{
+	success = sem.DecrementFor( 5.0, num );
+}
+
+void SemaphoreTest()
+{
+	typedef boost::chrono::process_cpu_clock CpuClock;
+
+	// Waiters needing different numbers of counters all get them
+	const int needs[] = { 2, 1, 3, 2, 1 };
+	const int numWaiters = 5;
+	Semaphore sem( 0 );
+	bool successes[numWaiters];
+	boost::thread_group waiters;
+	int total = 0;
+	for( int i = 0; i < numWaiters; ++i )
+	{
+		waiters.create_thread( boost::bind( &SemaphoreWaiter, boost::ref( sem ),
+		                                    needs[i], boost::ref( successes[i] ) ) );
+		total += needs[i];
+	}
+	boost::this_thread::sleep_for( boost::chrono::milliseconds( 20 ) );
+
+	// A single counter cannot satisfy the waiters needing more, which must
+	// sleep rather than wake each other
+	Semaphore starved( 0 );
+	bool starvedSuccesses[2];
+	boost::thread_group starvedWaiters;
+	for( int i = 0; i < 2; ++i )
+	{
+		starvedWaiters.create_thread( boost::bind( &SemaphoreWaiter, boost::ref( starved ),
+		                                           2, boost::ref( starvedSuccesses[i] ) ) );
+	}
+	boost::this_thread::sleep_for( boost::chrono::milliseconds( 20 ) );
+	CpuClock::time_point cpuStart = CpuClock::now();
+	starved.Increment( 1 );
+	boost::this_thread::sleep_for( boost::chrono::milliseconds( 200 ) );
+	CpuClock::duration cpuUsed = CpuClock::now() - cpuStart;
+	starved.Increment( 3 );
+	starvedWaiters.join_all();
+
+	for( int i = 0; i < total; ++i )
+	{
+		sem.Increment( 1 );
+		boost::this_thread::sleep_for( boost::chrono::milliseconds( 1 ) );
+	}
+	waiters.join_all();
+
+	bool passed = sem.Query() == 0 && starved.Query() == 0;
+	for( int i = 0; i < numWaiters; ++i ) { passed = passed && successes[i]; }
+	passed = passed && starvedSuccesses[0] && starvedSuccesses[1];
+
+	// Spinning waiters would use most of a core while the counter was short
+	double cpuSeconds = boost::chrono::duration<double>(
+	    boost::chrono::nanoseconds( cpuUsed.count().user + cpuUsed.count().system ) ).count();
+	passed = passed && cpuSeconds < 0.05;
+	std::cout << ( passed ? "Passed" : "Failed" ) << " semaphore test." << std::endl;
+}
+
+int main( int argc, char** argv )
+{
+	RingOverflowTest();
+	RingThreadTest();
+	BatchTest();
+	PolicyTest();
+	SingleProducerTest<std::deque>( "deque" );
+	SingleProducerTest<SpscRing>( "spsc" );
+	SpscOverflowTest();
+	PipelineTest();
+	SelectorTest();
+	SelectorStaleTest();
+	SemaphoreTest();
+	return 0;
+}
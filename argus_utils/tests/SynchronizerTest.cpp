@@ -0,0 +1,436 @@
+#include "argus_utils/geometry/PoseSE3.h"
+#include "argus_utils/synchronization/MessageSynchronizer3.hpp"
+#include "argus_utils/synchronization/WorkerPool.h"
+#include "argus_utils/utils/StampedRing.hpp"
+
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/thread/thread.hpp>
+#include <cmath>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+
+using namespace argus;
+
+typedef MessageSynchronizer<int> Synchronizer;
+typedef std::vector<Synchronizer::KeyedStampedData> SyncedSet;
+
+/*! \brief A direct matcher over ordered maps that scans every source for
+ * each candidate set, to check the heap-based matcher against. */
+class ReferenceSynchronizer
+{
+public:
+
+	ReferenceSynchronizer( unsigned int numSources, unsigned int bufferLen,
+	                       double maxDt, unsigned int minSyncNum )
+	: _buffers( numSources ), _bufferLen( bufferLen ), _maxDt( maxDt ),
+	  _minSyncNum( minSyncNum ) {}
+
+	void BufferData( unsigned int source, double t, int m )
+	{
+		std::map<double, int>& buffer = _buffers[source];
+		buffer[t] = m;
+		while( buffer.size() > _bufferLen ) { buffer.erase( buffer.begin() ); }
+	}
+
+	bool GetOutput( std::vector< std::pair<unsigned int, double> >& out )
+	{
+		out.clear();
+		while( true )
+		{
+			// Every buffer must have data, and the earliest is the candidate
+			double earliest = std::numeric_limits<double>::infinity();
+			for( unsigned int i = 0; i < _buffers.size(); ++i )
+			{
+				if( _buffers[i].empty() ) { return false; }
+				earliest = std::min( earliest, _buffers[i].begin()->first );
+			}
+
+			// All other data are later, so each buffer's closest is its head
+			std::vector<unsigned int> synced;
+			for( unsigned int i = 0; i < _buffers.size(); ++i )
+			{
+				if( _buffers[i].begin()->first - earliest <= _maxDt ) { synced.push_back( i ); }
+			}
+
+			unsigned int needed = _minSyncNum == 0 ? _buffers.size() : _minSyncNum;
+			if( synced.size() >= needed )
+			{
+				for( unsigned int j = 0; j < synced.size(); ++j )
+				{
+					std::map<double, int>& buffer = _buffers[synced[j]];
+					out.push_back( std::make_pair( synced[j], buffer.begin()->first ) );
+					buffer.erase( buffer.begin() );
+				}
+				return true;
+			}
+
+			for( unsigned int i = 0; i < _buffers.size(); ++i )
+			{
+				std::map<double, int>& buffer = _buffers[i];
+				while( !buffer.empty() && buffer.begin()->first <= earliest )
+				{
+					buffer.erase( buffer.begin() );
+				}
+			}
+		}
+	}
+
+private:
+
+	std::vector< std::map<double, int> > _buffers;
+	unsigned int _bufferLen;
+	double _maxDt;
+	unsigned int _minSyncNum;
+};
+
+int RandomInt( boost::mt19937& gen, int lo, int hi )
+{
+	boost::random::uniform_int_distribution<> dist( lo, hi );
+	return dist( gen );
+}
+
+void MatchingTest()
+{
+	// Fixed seed, so the same streams are compared on every run
+	boost::mt19937 gen( 3 );
+	unsigned int numMismatched = 0;
+	unsigned int numSets = 0;
+	for( int trial = 0; trial < 200; ++trial )
+	{
+		unsigned int numSources = RandomInt( gen, 1, 12 );
+		unsigned int minSync = RandomInt( gen, 0, 2 ) == 0 ? RandomInt( gen, 0, numSources ) : 0;
+		double maxDt = RandomInt( gen, 0, 4 ) * 0.01;
+		unsigned int bufferLen = RandomInt( gen, 1, 15 );
+
+		Synchronizer sync;
+		sync.SetMaxDt( maxDt );
+		sync.SetMinSyncNum( minSync );
+		sync.SetBufferLength( bufferLen );
+		ReferenceSynchronizer reference( numSources, bufferLen, maxDt, minSync );
+		std::vector<SourceHandle> handles;
+		for( unsigned int i = 0; i < numSources; ++i )
+		{
+			handles.push_back( sync.RegisterSource( std::string( 1, 'a' + i ) ) );
+		}
+
+		std::vector<double> lastTimes( numSources, 0 );
+		SyncedSet out;
+		std::vector< std::pair<unsigned int, double> > expected;
+		for( int step = 0; step < 500; ++step )
+		{
+			// Stamps on a 0.01 grid make ties at exactly max dt common
+			unsigned int i = RandomInt( gen, 0, numSources - 1 );
+			lastTimes[i] += RandomInt( gen, 1, 4 ) * 0.01;
+			int value = RandomInt( gen, 0, 1000 );
+			sync.BufferData( handles[i], lastTimes[i], value );
+			reference.BufferData( i, lastTimes[i], value );
+			if( RandomInt( gen, 0, 2 ) != 0 ) { continue; }
+
+			bool found = sync.GetOutput( out );
+			bool expectFound = reference.GetOutput( expected );
+			bool matched = found == expectFound && out.size() == expected.size();
+			for( unsigned int j = 0; j < out.size() && matched; ++j )
+			{
+				matched = std::get<0>( out[j] ) == std::string( 1, 'a' + expected[j].first ) &&
+				          std::get<1>( out[j] ) == expected[j].second;
+			}
+			if( !matched ) { ++numMismatched; }
+			if( found ) { ++numSets; }
+		}
+	}
+
+	// An infinite max dt syncs any data at once
+	Synchronizer sync;
+	sync.SetMaxDt( std::numeric_limits<double>::infinity() );
+	sync.RegisterSource( "a" );
+	sync.RegisterSource( "b" );
+	sync.BufferData( "a", 0.0, 0 );
+	sync.BufferData( "b", 1e6, 1 );
+	SyncedSet out;
+	bool passed = numMismatched == 0 && numSets > 0 &&
+	              sync.GetOutput( out ) && out.size() == 2;
+	std::cout << ( passed ? "Passed" : "Failed" ) << " matching test." << std::endl;
+}
+
+void StampedRingTest()
+{
+	boost::mt19937 gen( 5 );
+	StampedRing<int> ring( 2 );
+	std::map<double, int> reference;
+	bool passed = true;
+	for( int step = 0; step < 2000 && passed; ++step )
+	{
+		double t = RandomInt( gen, 0, 50 );
+		switch( RandomInt( gen, 0, 3 ) )
+		{
+		case 0:
+			passed = ring.Insert( t, step ) == reference.insert( std::make_pair( t, step ) ).second;
+			break;
+		case 1:
+			if( !reference.empty() )
+			{
+				size_t i = ring.LowerBound( t );
+				std::map<double, int>::iterator iter = reference.lower_bound( t );
+				passed = i == (size_t) std::distance( reference.begin(), iter );
+				if( passed && iter != reference.end() )
+				{
+					ring.Erase( i );
+					reference.erase( iter );
+				}
+			}
+			break;
+		case 2:
+			if( !reference.empty() )
+			{
+				ring.PopFront();
+				reference.erase( reference.begin() );
+			}
+			break;
+		default:
+			size_t i;
+			passed = ring.FindClosest( t, i ) == !reference.empty();
+			if( passed && !reference.empty() )
+			{
+				// Ties go to the later element
+				std::map<double, int>::iterator upper = reference.lower_bound( t );
+				std::map<double, int>::iterator closest = upper;
+				if( upper == reference.end() ||
+				    ( upper != reference.begin() && t - std::prev( upper )->first < upper->first - t ) )
+				{
+					closest = std::prev( upper );
+				}
+				passed = ring[i].first == closest->first && ring[i].second == closest->second;
+			}
+		}
+
+		passed = passed && ring.Size() == reference.size();
+		size_t j = 0;
+		for( std::map<double, int>::iterator iter = reference.begin();
+		     passed && iter != reference.end(); ++iter, ++j )
+		{
+			passed = ring[j].first == iter->first && ring[j].second == iter->second;
+		}
+	}
+	std::cout << ( passed ? "Passed" : "Failed" ) << " stamped ring test." << std::endl;
+}
+
+typedef MessageSynchronizer<VectorType> VectorSynchronizer;
+
+VectorType Signal( double offset, double slope, double t )
+{
+	VectorType v( 2 );
+	v << offset + slope * t, -slope * t;
+	return v;
+}
+
+/*! \brief Buffers linear signals from two sources, one with a gap, and
+ * returns the stamps of the interpolated sets. Clears valuesMatch if any
+ * value is off its signal. */
+std::vector<double> InterpolateSignals( bool useReference, bool& valuesMatch )
+{
+	VectorSynchronizer sync;
+	sync.SetBufferLength( 20 );
+	sync.SetMaxDt( 0.09 );
+	sync.SetInterpolation( true );
+	SourceHandle a = sync.RegisterSource( "a" );
+	SourceHandle b = sync.RegisterSource( "b" );
+	if( useReference ) { sync.SetReferenceSource( "b" ); }
+
+	// Source a skips from 0.22 to 0.52, farther apart than max dt
+	const double aStamps[] = { 0.02, 0.12, 0.22, 0.52, 0.62 };
+	for( unsigned int i = 0; i < 5; ++i )
+	{
+		sync.BufferData( a, aStamps[i], Signal( 1, 2, aStamps[i] ) );
+	}
+	for( int k = 0; k <= 12; ++k )
+	{
+		sync.BufferData( b, k * 0.05, Signal( 3, -1, k * 0.05 ) );
+	}
+
+	std::vector<VectorSynchronizer::KeyedStampedData> out;
+	std::vector<double> stamps;
+	while( sync.GetOutput( out ) )
+	{
+		double t = std::get<1>( out[0] );
+		stamps.push_back( t );
+		valuesMatch = valuesMatch && out.size() == 2 &&
+		              std::get<0>( out[0] ) == "a" && std::get<0>( out[1] ) == "b" &&
+		              ( std::get<2>( out[0] ) - Signal( 1, 2, t ) ).norm() < 1E-9 &&
+		              ( std::get<2>( out[1] ) - Signal( 3, -1, t ) ).norm() < 1E-9;
+		out.clear();
+	}
+	return stamps;
+}
+
+bool StampsEqual( const std::vector<double>& stamps, const double* expected, unsigned int num )
+{
+	if( stamps.size() != num ) { return false; }
+	for( unsigned int i = 0; i < num; ++i )
+	{
+		if( std::abs( stamps[i] - expected[i] ) > 1E-9 ) { return false; }
+	}
+	return true;
+}
+
+void InterpolationTest()
+{
+	// Without a reference every stamp is tried, and stamps with either
+	// neighbor of a's gap farther than max dt are rejected
+	bool passed = true;
+	const double allStamps[] = { 0.02, 0.05, 0.1, 0.12, 0.15, 0.2, 0.22, 0.52, 0.55, 0.6 };
+	passed = StampsEqual( InterpolateSignals( false, passed ), allStamps, 10 ) && passed;
+
+	// A reference source limits the stamps to its own
+	const double referenceStamps[] = { 0.05, 0.1, 0.15, 0.2, 0.55, 0.6 };
+	passed = StampsEqual( InterpolateSignals( true, passed ), referenceStamps, 6 ) && passed;
+
+	Synchronizer plain;
+	try
+	{
+		plain.SetInterpolation( true );
+		passed = false;
+	}
+	catch( std::invalid_argument& e ) {}
+
+	// A quarter turn about z with a rise along z is a pure screw motion, so
+	// its geodesic midpoint is an eighth turn at half the rise
+	PoseSE3 start;
+	PoseSE3 end( 0, 0, 2, std::cos( M_PI / 4 ), 0, 0, std::sin( M_PI / 4 ) );
+	PoseSE3 midpoint( 0, 0, 1, std::cos( M_PI / 8 ), 0, 0, std::sin( M_PI / 8 ) );
+	PoseSE3 interpolated = InterpolationTraits<PoseSE3>::Interpolate( start, end, 0.5 );
+	passed = passed && ( interpolated.ToMatrix() - midpoint.ToMatrix() ).norm() < 1E-9;
+
+	std::cout << ( passed ? "Passed" : "Failed" ) << " interpolation test." << std::endl;
+}
+
+/*! \brief Records the sets passed to a handler, which blocks until the gate
+ * is opened. */
+struct PushRecorder
+{
+	boost::mutex mutex;
+	boost::condition_variable gateOpened;
+	bool gateOpen;
+	Synchronizer* clearer; // Tries to clear this handler from within it
+	bool clearRejected;
+	int numConcurrent;
+	int maxConcurrent;
+	bool setsComplete;
+	std::vector<double> stamps;
+
+	PushRecorder()
+	: gateOpen( false ), clearer( nullptr ), clearRejected( false ),
+	  numConcurrent( 0 ), maxConcurrent( 0 ), setsComplete( true ) {}
+
+	void Handle( const SyncedSet& set )
+	{
+		boost::unique_lock<boost::mutex> lock( mutex );
+		maxConcurrent = std::max( maxConcurrent, ++numConcurrent );
+		while( !gateOpen ) { gateOpened.wait( lock ); }
+
+		setsComplete = setsComplete && set.size() == 2 &&
+		               std::get<1>( set[0] ) == std::get<1>( set[1] );
+		stamps.push_back( std::get<1>( set[0] ) );
+		if( clearer )
+		{
+			lock.unlock();
+			try { clearer->ClearOutputHandler(); }
+			catch( std::logic_error& e ) { clearRejected = true; }
+			lock.lock();
+			clearer = nullptr;
+		}
+		--numConcurrent;
+	}
+
+	void OpenGate()
+	{
+		boost::unique_lock<boost::mutex> lock( mutex );
+		gateOpen = true;
+		gateOpened.notify_all();
+	}
+
+	size_t NumReceived()
+	{
+		boost::unique_lock<boost::mutex> lock( mutex );
+		return stamps.size();
+	}
+};
+
+void BufferPairs( Synchronizer& sync, int start, int end )
+{
+	for( int i = start; i < end; ++i )
+	{
+		sync.BufferData( "a", i, i );
+		sync.BufferData( "b", i, -i );
+	}
+}
+
+void PushTest()
+{
+	const unsigned int maxInFlight = 3;
+	const int numSets = 20;
+	WorkerPool pool( 4 );
+	pool.StartWorkers();
+	PushRecorder recorder;
+	std::unique_ptr<Synchronizer> sync( new Synchronizer() );
+	sync->SetBufferLength( 2 * numSets );
+	sync->RegisterSource( "a" );
+	sync->RegisterSource( "b" );
+
+	// Handlers need running workers
+	bool passed = false;
+	WorkerPool stopped;
+	try { sync->SetOutputHandler( boost::bind( &PushRecorder::Handle, &recorder, _1 ), stopped ); }
+	catch( std::invalid_argument& e ) { passed = true; }
+
+	// With the handler blocked, matching stops at the in-flight limit, and
+	// clearing the handler leaves the rest buffered
+	sync->SetOutputHandler( boost::bind( &PushRecorder::Handle, &recorder, _1 ),
+	                        pool, maxInFlight );
+	BufferPairs( *sync, 0, numSets );
+	boost::this_thread::sleep_for( boost::chrono::milliseconds( 100 ) );
+	boost::thread clearThread( boost::bind( &Synchronizer::ClearOutputHandler, sync.get() ) );
+	boost::this_thread::sleep_for( boost::chrono::milliseconds( 50 ) );
+	recorder.OpenGate();
+	clearThread.join();
+
+	size_t numPushed = recorder.NumReceived();
+	passed = passed && numPushed >= 1 && numPushed <= maxInFlight;
+	std::vector<SyncedSet> rest;
+	sync->GetAllOutputs( rest );
+	for( unsigned int i = 0; i < rest.size(); ++i )
+	{
+		recorder.stamps.push_back( std::get<1>( rest[i][0] ) );
+	}
+
+	// Clearing from within the handler is rejected rather than deadlocking
+	recorder.clearer = sync.get();
+	sync->SetOutputHandler( boost::bind( &PushRecorder::Handle, &recorder, _1 ),
+	                        pool, maxInFlight );
+	BufferPairs( *sync, numSets, 2 * numSets );
+	for( int i = 0; i < 100 && recorder.NumReceived() < 2 * numSets; ++i )
+	{
+		boost::this_thread::sleep_for( boost::chrono::milliseconds( 10 ) );
+	}
+	sync.reset();
+
+	passed = passed && recorder.stamps.size() == 2 * numSets &&
+	         recorder.setsComplete && recorder.clearRejected &&
+	         recorder.maxConcurrent == 1;
+	for( int i = 0; i < 2 * numSets && passed; ++i )
+	{
+		passed = recorder.stamps[i] == i;
+	}
+	std::cout << ( passed ? "Passed" : "Failed" ) << " push test." << std::endl;
+}
+
+int main( int argc, char** argv )
+{
+	MatchingTest();
+	StampedRingTest();
+	InterpolationTest();
+	PushTest();
+	return 0;
+}
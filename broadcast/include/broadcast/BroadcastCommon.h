@@ -2,6 +2,7 @@
 
 #include "broadcast/FloatVectorStamped.h"
 #include "broadcast/QueryFeatures.h"
+#include "argus_utils/utils/InterpolationTraits.hpp"
 #include "argus_utils/utils/LinalgTypes.h"
 #include <string>
 
@@ -39,4 +40,16 @@ struct StampedFeatures
 	broadcast::FloatVectorStamped ToMsg() const;
 };
 
+/*! \brief Features interpolate linearly, along with their time. The name
+ * is taken from the first. */
+template <>
+struct InterpolationTraits<StampedFeatures>
+{
+	static const bool IsInterpolable = true;
+
+	static StampedFeatures Interpolate( const StampedFeatures& a,
+	                                    const StampedFeatures& b,
+	                                    double alpha );
+};
+
 }
\ No newline at end of file
@@ -12,12 +12,14 @@
 namespace argus
 {
 
-/*! \brief Wraps looking up, receiving, and caching a data broadcast. */
-class BroadcastReceiver
+/*! \brief Wraps looking up, receiving, and caching a data broadcast. The
+ * lock policy is instantiated for the policies in SynchronizationTypes.h. */
+template <typename LockPolicy = DefaultLockPolicy>
+class BasicBroadcastReceiver
 {
 public:
 
-	BroadcastReceiver();
+	BasicBroadcastReceiver();
 
 	void Initialize( const std::string& streamName,
 	                 const YAML::Node& props );
@@ -46,6 +48,10 @@ public:
 
 private:
 
+	typedef typename LockPolicy::Mutex Mutex;
+	typedef typename LockPolicy::ReadLock ReadLock;
+	typedef typename LockPolicy::WriteLock WriteLock;
+
 	mutable Mutex _mutex;
 
 	ros::NodeHandle _nodeHandle;
@@ -71,4 +77,6 @@ private:
 	double GetTimespan() const;
 };
 
+typedef BasicBroadcastReceiver<> BroadcastReceiver;
+
 }
\ No newline at end of file
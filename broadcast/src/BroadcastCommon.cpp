@@ -91,4 +91,17 @@ broadcast::FloatVectorStamped StampedFeatures::ToMsg() const
 	return msg;
 }
 
+StampedFeatures
+InterpolationTraits<StampedFeatures>::Interpolate( const StampedFeatures& a,
+                                                  const StampedFeatures& b,
+                                                  double alpha )
+{
+	ros::Duration span = b.time - a.time;
+	return StampedFeatures( a.time + ros::Duration( alpha * span.toSec() ),
+	                        a.name,
+	                        InterpolationTraits<VectorType>::Interpolate( a.features,
+	                                                                      b.features,
+	                                                                      alpha ) );
+}
+
 }
\ No newline at end of file
@@ -11,12 +11,16 @@
 namespace argus
 {
 
-BroadcastReceiver::BroadcastReceiver() 
+template <typename LockPolicy>
+BasicBroadcastReceiver<LockPolicy>::BasicBroadcastReceiver() 
 : _nodeHandle(), _lookup(), _infoManager( _lookup ), _initialized( false )
-{}
+{
+	NameLock( _mutex, "BroadcastReceiver::cache" );
+}
 
-void BroadcastReceiver::Initialize( const std::string& streamName,
-                                    const YAML::Node& props )
+template <typename LockPolicy>
+void BasicBroadcastReceiver<LockPolicy>::Initialize( const std::string& streamName,
+                                                     const YAML::Node& props )
 {
 	std::string queryStr;
 	GetParamRequired( props, "query_mode", queryStr );
@@ -51,9 +55,10 @@ void BroadcastReceiver::Initialize( const std::string& streamName,
 	}
 }
 
-void BroadcastReceiver::InitializePullStream( const std::string& streamName,
-                                              const std::string& topic,
-                                              QueryMode mode )
+template <typename LockPolicy>
+void BasicBroadcastReceiver<LockPolicy>::InitializePullStream( const std::string& streamName,
+                                                               const std::string& topic,
+                                                               QueryMode mode )
 {
 	_streamName = streamName;
 	_queryMode = mode;
@@ -63,11 +68,12 @@ void BroadcastReceiver::InitializePullStream( const std::string& streamName,
 	_pullClient = _nodeHandle.serviceClient<broadcast::QueryFeatures>( topic, true );
 }
 
-void BroadcastReceiver::InitializePushStream( const std::string& streamName,
-                                              const std::string& topic,
-                                              QueryMode mode,
-                                              double cacheTime,
-                                              unsigned int queueSize )
+template <typename LockPolicy>
+void BasicBroadcastReceiver<LockPolicy>::InitializePushStream( const std::string& streamName,
+                                                               const std::string& topic,
+                                                               QueryMode mode,
+                                                               double cacheTime,
+                                                               unsigned int queueSize )
 {
 	_streamName = streamName;
 	_queryMode = mode;
@@ -76,28 +82,32 @@ void BroadcastReceiver::InitializePushStream( const std::string& streamName,
 	_initialized = true;
 	_pushSub = _nodeHandle.subscribe( topic, 
 	                                  queueSize, 
-	                                  &BroadcastReceiver::FeatureCallback, 
+	                                  &BasicBroadcastReceiver::FeatureCallback, 
 	                                  this );
 }
 
-void BroadcastReceiver::SetCacheTime( double cacheTime )
+template <typename LockPolicy>
+void BasicBroadcastReceiver<LockPolicy>::SetCacheTime( double cacheTime )
 {
 	WriteLock lock( _mutex );
 
 	_maxTimespan = cacheTime;
 }
 
-unsigned int BroadcastReceiver::GetDim() const
+template <typename LockPolicy>
+unsigned int BasicBroadcastReceiver<LockPolicy>::GetDim() const
 {
 	return _infoManager.GetInfo( _streamName ).featureSize;
 }
 
-const std::string& BroadcastReceiver::GetStreamName() const
+template <typename LockPolicy>
+const std::string& BasicBroadcastReceiver<LockPolicy>::GetStreamName() const
 {
 	return _streamName;
 }
 
-bool BroadcastReceiver::IsReady() const
+template <typename LockPolicy>
+bool BasicBroadcastReceiver<LockPolicy>::IsReady() const
 {
 	ReadLock lock( _mutex );
 	switch( _infoManager.GetInfo( _streamName ).mode )
@@ -111,7 +121,8 @@ bool BroadcastReceiver::IsReady() const
 	}
 }
 
-bool BroadcastReceiver::ReadStream( const ros::Time& time, StampedFeatures& f ) const
+template <typename LockPolicy>
+bool BasicBroadcastReceiver<LockPolicy>::ReadStream( const ros::Time& time, StampedFeatures& f ) const
 {
 	ReadLock lock( _mutex );
 	
@@ -126,17 +137,20 @@ bool BroadcastReceiver::ReadStream( const ros::Time& time, StampedFeatures& f )
 	}
 }
 
-ros::Time BroadcastReceiver::EarliestTime() const
+template <typename LockPolicy>
+ros::Time BasicBroadcastReceiver<LockPolicy>::EarliestTime() const
 {
 	return get_lowest_key( _featureCache );
 }
 
-ros::Time BroadcastReceiver::LatestTime() const
+template <typename LockPolicy>
+ros::Time BasicBroadcastReceiver<LockPolicy>::LatestTime() const
 {
 	return get_highest_key( _featureCache );
 }
 
-bool BroadcastReceiver::PullStream( const ros::Time& time, StampedFeatures& f ) const
+template <typename LockPolicy>
+bool BasicBroadcastReceiver<LockPolicy>::PullStream( const ros::Time& time, StampedFeatures& f ) const
 {
 	broadcast::QueryFeatures srv;
 	srv.request.time_mode = _queryMode;
@@ -149,9 +163,10 @@ bool BroadcastReceiver::PullStream( const ros::Time& time, StampedFeatures& f )
 	return true;
 }
 
-bool BroadcastReceiver::ReadCached( const ros::Time& time, StampedFeatures& f ) const
+template <typename LockPolicy>
+bool BasicBroadcastReceiver<LockPolicy>::ReadCached( const ros::Time& time, StampedFeatures& f ) const
 {
-	StreamCache::const_iterator closest = _featureCache.end();
+	typename StreamCache::const_iterator closest = _featureCache.end();
 
 	switch( _queryMode )
 	{
@@ -181,7 +196,8 @@ bool BroadcastReceiver::ReadCached( const ros::Time& time, StampedFeatures& f )
 	return true;
 }
 
-void BroadcastReceiver::FeatureCallback( const broadcast::FloatVectorStamped::ConstPtr& msg )
+template <typename LockPolicy>
+void BasicBroadcastReceiver<LockPolicy>::FeatureCallback( const broadcast::FloatVectorStamped::ConstPtr& msg )
 {
 	WriteLock lock( _mutex );
 	
@@ -202,7 +218,8 @@ void BroadcastReceiver::FeatureCallback( const broadcast::FloatVectorStamped::Co
 	CheckTimespan();
 }
 
-double BroadcastReceiver::GetTimespan() const
+template <typename LockPolicy>
+double BasicBroadcastReceiver<LockPolicy>::GetTimespan() const
 {
 	if( _featureCache.empty() ) { return 0; }
 	ros::Time latestTime = _featureCache.rbegin()->first;
@@ -210,7 +227,8 @@ double BroadcastReceiver::GetTimespan() const
 	return (latestTime - earliestTime).toSec();
 }
 
-void BroadcastReceiver::CheckTimespan()
+template <typename LockPolicy>
+void BasicBroadcastReceiver<LockPolicy>::CheckTimespan()
 {
 	
 	ros::Time latestTime = _featureCache.rbegin()->first;
@@ -223,4 +241,10 @@ void BroadcastReceiver::CheckTimespan()
 	}
 }
 
+template class BasicBroadcastReceiver<NullLockPolicy>;
+template class BasicBroadcastReceiver<SpinLockPolicy>;
+template class BasicBroadcastReceiver<StdLockPolicy>;
+template class BasicBroadcastReceiver<SharedLockPolicy>;
+template class BasicBroadcastReceiver<ProfiledLockPolicy>;
+
 }
\ No newline at end of file
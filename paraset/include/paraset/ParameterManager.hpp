@@ -23,13 +23,17 @@ namespace argus
 {
 
 // TODO Introduce better support for booleans?
-template<typename T>
+template<typename T, typename LockPolicy = DefaultLockPolicy>
 class ParameterManager
 {
 public:
 
 	typedef boost::function<void ( const T& )> Callback;
 
+	typedef typename LockPolicy::Mutex Mutex;
+	typedef typename LockPolicy::ReadLock ReadLock;
+	typedef typename LockPolicy::WriteLock WriteLock;
+
 	ParameterManager() : _name( "" ) {}
 
 	// TODO Have initialval set after checks are added?
@@ -46,13 +50,13 @@ public:
 		                 "\tDescription: " << description << std::endl <<
 		                 "\tInitial value: " << initialVal );
 		_setServer = nodeHandle.advertiseService( "set_" + _name,
-		                                          &ParameterManager<T>::SetParameterCallback,
+		                                          &ParameterManager::SetParameterCallback,
 		                                          this );
 		_getServer = nodeHandle.advertiseService( "get_" + _name,
-		                                          &ParameterManager<T>::GetParameterCallback,
+		                                          &ParameterManager::GetParameterCallback,
 												  this );
 		_infoServer = nodeHandle.advertiseService( "get_" + _name + "_info",
-		                                           &ParameterManager<T>::GetInfoCallback,
+		                                           &ParameterManager::GetInfoCallback,
 		                                           this );
 	}
 